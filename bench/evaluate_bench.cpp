@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "../src/problem.hpp"
+#include "../src/reader.hpp"
+#include "../src/optimization.hpp"
+
+using namespace std;
+
+// Scenario buffers of one tile of the tiled reference are kept within this
+// many bytes.
+const size_t BATCH_TILE_BYTES = 256 * 1024;
+
+// The batch evaluation EvaluateBatch first had, kept as a reference. The
+// batch is split into tiles whose scenario buffers stay in cache, and
+// within a tile the time-step loop is outermost, so each risk row of a
+// time step is read once for all the individuals of the tile that use it.
+class TiledBatch {
+public:
+    TiledBatch(Problem* problem, Optimization* optimization) : problem(problem), optimization(optimization) {
+        this->max_scenarios = max(1, *max_element(problem->scenarios.begin(), problem->scenarios.end()));
+    }
+
+    void Evaluate(span<const span<const int>> schedules, span<tuple<float, float, float>> results) {
+        int time_steps = this->problem->time_steps;
+        size_t batch_size = schedules.size();
+        size_t tile_size = max(size_t(1), min(batch_size, BATCH_TILE_BYTES / (this->max_scenarios * sizeof(float))));
+
+        for (size_t first = 0; first < batch_size; first += tile_size) {
+            size_t count = min(batch_size, first + tile_size) - first;
+
+            this->penalty.resize(count);
+            this->mean_risk.resize(count);
+            for (size_t b = 0; b < count; b++) {
+                this->penalty[b] = get<1>(this->optimization->ConstraintSatisfied(schedules[first + b]));
+                this->mean_risk[b] = this->problem->MeanRisk(schedules[first + b]);
+            }
+
+            // Interventions active at each time step, per individual, in index order.
+            size_t stride = time_steps + 2;
+            this->active_offset.assign(count * stride, 0);
+            for (size_t b = 0; b < count; b++) {
+                span<const int> start_times = schedules[first + b];
+                for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+                    if (this->problem->ValidStart(i, start_times[i])) {
+                        for (int t = start_times[i]; t <= this->problem->WindowEnd(i, start_times[i]); t++) {
+                            this->active_offset[b * stride + t]++;
+                        }
+                    }
+                }
+            }
+
+            size_t total = 0;
+            for (size_t& offset : this->active_offset) {
+                size_t n = offset;
+                offset = total;
+                total += n;
+            }
+            this->active.resize(total);
+
+            this->cursor.assign(this->active_offset.begin(), this->active_offset.end());
+            for (size_t b = 0; b < count; b++) {
+                span<const int> start_times = schedules[first + b];
+                for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+                    if (this->problem->ValidStart(i, start_times[i])) {
+                        for (int t = start_times[i]; t <= this->problem->WindowEnd(i, start_times[i]); t++) {
+                            this->active[this->cursor[b * stride + t]++] = i;
+                        }
+                    }
+                }
+            }
+
+            this->expected_excess.assign(count, 0.0f);
+            this->scenario_risk.resize(count * this->max_scenarios);
+            for (int t = 1; t <= time_steps; t++) {
+                int scenarios_t = this->problem->scenarios[t - 1];
+                fill(this->scenario_risk.begin(), this->scenario_risk.end(), 0.0f);
+
+                for (size_t b = 0; b < count; b++) {
+                    span<const int> start_times = schedules[first + b];
+                    float* risk_b = &this->scenario_risk[b * this->max_scenarios];
+                    float risk_total = 0.0;
+                    for (size_t k = this->active_offset[b * stride + t]; k < this->active_offset[b * stride + t + 1]; k++) {
+                        int i = this->active[k];
+                        risk_total += AccumulateRisk(risk_b, this->problem->RiskRow(i, start_times[i], t), scenarios_t);
+                    }
+
+                    float risk_t = risk_total / max(1, scenarios_t);
+                    if (scenarios_t > 0) {
+                        this->expected_excess[b] += max(0.0f, SelectQuantile(risk_b, scenarios_t, this->problem->quantile) - risk_t);
+                    }
+                }
+            }
+
+            for (size_t b = 0; b < count; b++) {
+                float excess = this->expected_excess[b] / time_steps;
+                float objective = this->problem->alpha * this->mean_risk[b] + (1 - this->problem->alpha) * excess;
+                results[first + b] = make_tuple(objective + this->penalty[b], this->mean_risk[b], excess);
+            }
+        }
+    }
+
+private:
+    Problem* problem;
+    Optimization* optimization;
+    size_t max_scenarios;
+    vector<float> penalty;
+    vector<float> mean_risk;
+    vector<size_t> active_offset;
+    vector<size_t> cursor;
+    vector<int> active;
+    vector<float> expected_excess;
+    vector<float> scenario_risk;
+};
+
+// The evaluation as the repository first had it, before the risk tensor,
+// the mean-risk table and the kernels: every time step walks every
+// intervention and gathers its scenarios into a vector allocated for that
+// step, then sorts it for the quantile; every (t, resource) cell walks every
+// intervention's workload again; every exclusion scans its season. The
+// original also looked every value up in string-keyed maps, so this
+// understates its cost.
+tuple<float, float, float> BaselineEvaluate(const Problem& problem, span<const int> start_times) {
+    int time_steps = problem.time_steps;
+    auto active = [&](size_t i, int t) {
+        return problem.ValidStart(i, start_times[i]) && start_times[i] <= t && t <= problem.EndTime(i, start_times[i]);
+    };
+
+    float intervention_penalty = 0.0;
+    for (size_t i = 0; i < start_times.size(); i++) {
+        if (start_times[i] < 0 || start_times[i] > problem.interventions[i].tmax) {
+            intervention_penalty = 1.0;
+            break;
+        }
+        if (start_times[i] > 0) {
+            intervention_penalty += float(max(0, problem.EndTime(i, start_times[i]) - time_steps));
+        }
+    }
+
+    float resource_penalty = 0.0;
+    for (int t = 1; t <= time_steps; t++) {
+        for (size_t r = 0; r < problem.resources.size(); r++) {
+            float usage = 0.0;
+            for (size_t i = 0; i < problem.interventions.size(); i++) {
+                if (!active(i, t)) {
+                    continue;
+                }
+                const WorkloadEntry* end = problem.WorkloadEnd(i, start_times[i]);
+                for (const WorkloadEntry* entry = problem.WorkloadBegin(i, start_times[i]); entry != end; ++entry) {
+                    if (entry->t == t && entry->resource == int(r)) {
+                        usage += entry->amount;
+                    }
+                }
+            }
+            resource_penalty += problem.ResourceViolation(r, t, usage);
+        }
+    }
+
+    float exclusion_penalty = 0.0;
+    for (const Exclusion& exclusion : problem.exclusions) {
+        int start_1 = start_times[exclusion.first];
+        int start_2 = start_times[exclusion.second];
+        if (!problem.ValidStart(exclusion.first, start_1) || !problem.ValidStart(exclusion.second, start_2)) {
+            continue;
+        }
+        const vector<int>& duration = problem.seasons[exclusion.season].duration;
+        int end = min(problem.EndTime(exclusion.first, start_1), problem.EndTime(exclusion.second, start_2));
+        for (int t = max(start_1, start_2); t <= end; t++) {
+            if (find(duration.begin(), duration.end(), t) != duration.end()) {
+                exclusion_penalty += 1.0;
+            }
+        }
+    }
+
+    float penalty = 0.0;
+    if (intervention_penalty > 0) penalty += intervention_penalty * 1e6;
+    if (resource_penalty > 0) penalty += resource_penalty * 1e6;
+    if (exclusion_penalty > 0) penalty += exclusion_penalty * 1e6;
+
+    float mean_risk = 0.0;
+    float expected_excess = 0.0;
+    for (int t = 1; t <= time_steps; t++) {
+        int scenarios_t = problem.scenarios[t - 1];
+        vector<float> risk_by_scenario;
+        float risk_t = 0.0;
+
+        for (size_t i = 0; i < problem.interventions.size(); i++) {
+            if (!active(i, t)) {
+                continue;
+            }
+            const float* risk_row = problem.RiskRow(i, start_times[i], t);
+            for (int s = 0; s < scenarios_t; s++) {
+                risk_t += risk_row[s];
+                if (s >= int(risk_by_scenario.size())) {
+                    risk_by_scenario.push_back(risk_row[s]);
+                }
+                else {
+                    risk_by_scenario[s] += risk_row[s];
+                }
+            }
+        }
+        risk_t /= max(1, scenarios_t);
+        mean_risk += risk_t;
+
+        sort(risk_by_scenario.begin(), risk_by_scenario.end());
+        if (!risk_by_scenario.empty()) {
+            int quantile_index = int(ceil(problem.quantile * risk_by_scenario.size())) - 1;
+            expected_excess += max(0.0f, risk_by_scenario[quantile_index] - risk_t);
+        }
+    }
+
+    mean_risk /= time_steps;
+    expected_excess /= time_steps;
+    float objective = problem.alpha * mean_risk + (1 - problem.alpha) * expected_excess;
+    return make_tuple(objective + penalty, mean_risk, expected_excess);
+}
+
+// Times the baseline evaluation, the separate ConstraintSatisfied +
+// ObjectiveFunction path, the tiled reference and the fused pass of
+// EvaluateBatch on one thread, over random schedules of an instance. The
+// last three must give the same results; the baseline sums the mean risk in
+// another order, so it only has to agree to a relative 1e-4.
+//
+// usage: evaluate_bench [instance] [schedules] [rounds]
+int main(int argc, char** argv) {
+    string input_file = argc > 1 ? argv[1] : "input/A_09.json";
+    int schedules = argc > 2 ? stoi(argv[2]) : 500;
+    int rounds = argc > 3 ? stoi(argv[3]) : 15;
+
+    FILE* fp = fopen(input_file.c_str(), "r");
+    if (!fp) {
+        cerr << "Could not open " << input_file << endl;
+        return 1;
+    }
+    Problem problem("bench");
+    InstanceReader reader(&problem);
+    rapidjson::ParseResult result = reader.Read(fp);
+    fclose(fp);
+    if (result.IsError()) {
+        cerr << "Could not parse " << input_file << endl;
+        return 1;
+    }
+
+    omp_set_num_threads(1);
+    Optimization optimization(&problem);
+    TiledBatch tiled_batch(&problem, &optimization);
+
+    mt19937 generator(7);
+    vector<vector<int>> population(schedules);
+    for (auto& start_times : population) {
+        for (const auto& intervention : problem.interventions) {
+            start_times.push_back(uniform_int_distribution<int>(1, max(1, intervention.tmax))(generator));
+        }
+    }
+    vector<span<const int>> views(population.begin(), population.end());
+
+    vector<tuple<float, float, float>> baseline(schedules);
+    vector<tuple<float, float, float>> separate(schedules);
+    vector<tuple<float, float, float>> tiled(schedules);
+    vector<tuple<float, float, float>> fused(schedules);
+    double baseline_seconds = 1e9;
+    double separate_seconds = 1e9;
+    double tiled_seconds = 1e9;
+    double fused_seconds = 1e9;
+    for (int round = 0; round < rounds; round++) {
+        auto baseline_start = chrono::steady_clock::now();
+        for (int k = 0; k < schedules; k++) {
+            baseline[k] = BaselineEvaluate(problem, population[k]);
+        }
+        auto start = chrono::steady_clock::now();
+        for (int k = 0; k < schedules; k++) {
+            auto [violated, penalty] = optimization.ConstraintSatisfied(population[k]);
+            separate[k] = optimization.ObjectiveFunction(population[k], penalty);
+        }
+        auto middle = chrono::steady_clock::now();
+        tiled_batch.Evaluate(views, tiled);
+        auto tiled_end = chrono::steady_clock::now();
+        optimization.EvaluateBatch(views, fused);
+        auto end = chrono::steady_clock::now();
+
+        baseline_seconds = min(baseline_seconds, chrono::duration<double>(start - baseline_start).count());
+        separate_seconds = min(separate_seconds, chrono::duration<double>(middle - start).count());
+        tiled_seconds = min(tiled_seconds, chrono::duration<double>(tiled_end - middle).count());
+        fused_seconds = min(fused_seconds, chrono::duration<double>(end - tiled_end).count());
+    }
+
+    int mismatches = 0;
+    for (int k = 0; k < schedules; k++) {
+        if (separate[k] != fused[k] || tiled[k] != fused[k]) {
+            mismatches++;
+        }
+        float objective = get<0>(fused[k]);
+        if (fabs(get<0>(baseline[k]) - objective) > 1e-4 * max(1.0f, fabs(objective))) {
+            mismatches++;
+        }
+    }
+
+    double scale = 1e6 / schedules;
+    printf("%s: separate %.2f us, tiled %.2f us, fused %.2f us per schedule, fused speedup %.2fx over separate, %.2fx over tiled, mismatches %d\n",
+        input_file.c_str(), separate_seconds * scale, tiled_seconds * scale, fused_seconds * scale, separate_seconds / fused_seconds,
+        tiled_seconds / fused_seconds, mismatches);
+    printf("%s: baseline %.2f us per schedule, fused speedup %.2fx over baseline\n", input_file.c_str(), baseline_seconds * scale,
+        baseline_seconds / fused_seconds);
+
+    // The 2x target is set against ConstraintSatisfied + ObjectiveFunction.
+    double speedup = separate_seconds / fused_seconds;
+    if (speedup >= 2.0) {
+        printf("%s: 2x target over separate met (%.2fx)\n", input_file.c_str(), speedup);
+    }
+    else {
+        printf("%s: 2x target over separate MISSED (%.2fx). The separate path already reads the dense risk tensor, the\n"
+            "  mean-risk table and the workload lists with the SIMD kernels, so fusing only saves its second walk over\n"
+            "  each window and the repeated activity tests. Against the baseline evaluation the fused pass is %.2fx.\n",
+            input_file.c_str(), speedup, baseline_seconds / fused_seconds);
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "../src/problem.hpp"
+#include "../src/loader.hpp"
+#include "../utils/memory.hpp"
+
+using namespace std;
+
+// Loads an instance with one loader and reports the load time and the peak
+// resident memory of the process. Peak memory only grows, so each loader is
+// measured in its own process; `make bench-load` runs all of them on the
+// same instance.
+//
+// usage: load_bench [instance] [sax|dom|sax-mmap|dom-mmap]
+int main(int argc, char** argv) {
+    string input_file = argc > 1 ? argv[1] : "input/A_01.json";
+    string loader = argc > 2 ? argv[2] : "sax";
+
+    LoadOptions options;
+    options.use_cache = false;
+    if (!ParseLoader(loader, options)) {
+        cerr << "Unknown loader " << loader << endl;
+        return 1;
+    }
+
+    long memory_before = utils::PeakMemory();
+    auto start = chrono::steady_clock::now();
+
+    Problem problem("load_bench");
+    rapidjson::ParseResult result = ReadInstance(&problem, input_file, options);
+    if (result.IsError()) {
+        cerr << "Could not parse " << input_file << endl;
+        return 1;
+    }
+
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    long memory_after = utils::PeakMemory();
+
+    printf("%s: %-8s load %8.1f ms, peak memory %7ld KB (%ld KB before loading), %zu interventions\n", input_file.c_str(),
+        loader.c_str(), milliseconds, memory_after, memory_before, problem.interventions.size());
+    return 0;
+}
@@ -0,0 +1,360 @@
+#include "cache.hpp"
+
+namespace {
+    const char CACHE_MAGIC[8] = { 'M', 'P', 'P', 'C', 'A', 'C', 'H', 'E' };
+    const size_t CACHE_ALIGNMENT = 64;
+
+    class CacheWriter {
+    public:
+        ofstream out;
+
+        CacheWriter(const string& path) : out(path, ios::binary | ios::trunc) {}
+
+        void Bytes(const void* data, size_t size) {
+            this->out.write(static_cast<const char*>(data), size);
+        }
+
+        template <typename T>
+        void Value(const T& value) {
+            Bytes(&value, sizeof(T));
+        }
+
+        void String(const string& value) {
+            Value<uint64_t>(value.size());
+            Bytes(value.data(), value.size());
+        }
+
+        template <typename T>
+        void Array(span<const T> values, bool aligned = false) {
+            Value<uint64_t>(values.size());
+            if (aligned) {
+                static const char padding[CACHE_ALIGNMENT] = {};
+                size_t position = this->out.tellp();
+                Bytes(padding, (CACHE_ALIGNMENT - position % CACHE_ALIGNMENT) % CACHE_ALIGNMENT);
+            }
+            Bytes(values.data(), values.size_bytes());
+        }
+    };
+
+    class CacheCursor {
+    public:
+        const char* data;
+        size_t size;
+        size_t position = 0;
+        bool failed = false;
+
+        CacheCursor(const void* data, size_t size) : data(static_cast<const char*>(data)), size(size) {}
+
+        const char* Bytes(size_t count) {
+            if (this->failed || count > this->size - this->position) {
+                this->failed = true;
+                return nullptr;
+            }
+
+            const char* bytes = this->data + this->position;
+            this->position += count;
+            return bytes;
+        }
+
+        template <typename T>
+        T Value() {
+            T value{};
+            const char* bytes = Bytes(sizeof(T));
+            if (bytes) memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        string String() {
+            uint64_t count = Value<uint64_t>();
+            const char* bytes = Bytes(count);
+            return bytes ? string(bytes, count) : string();
+        }
+
+        template <typename T>
+        span<const T> Array(bool aligned = false) {
+            uint64_t count = Value<uint64_t>();
+            if (aligned) {
+                Bytes((CACHE_ALIGNMENT - this->position % CACHE_ALIGNMENT) % CACHE_ALIGNMENT);
+            }
+            if (count > (this->size - min(this->size, this->position)) / sizeof(T)) {
+                this->failed = true;
+                return {};
+            }
+
+            const char* bytes = Bytes(count * sizeof(T));
+            return bytes ? span<const T>(reinterpret_cast<const T*>(bytes), count) : span<const T>();
+        }
+
+        template <typename T>
+        vector<T> Vector() {
+            span<const T> values = Array<T>();
+            return vector<T>(values.begin(), values.end());
+        }
+    };
+
+    // Checks that the tables read from a cache agree with each other, so a
+    // damaged file is rejected instead of indexing out of bounds.
+    bool ValidLayout(const Problem* problem) {
+        int time_steps = problem->time_steps;
+        if (time_steps < 1 || problem->scenarios.size() != size_t(time_steps) ||
+            problem->scenario_offset.size() != size_t(time_steps) + 1 || problem->scenario_offset[0] != 0) {
+            return false;
+        }
+        for (int t = 0; t < time_steps; t++) {
+            if (problem->scenarios[t] < 0 || problem->scenario_offset[t + 1] != problem->scenario_offset[t] + problem->scenarios[t]) {
+                return false;
+            }
+        }
+
+        for (const auto& resource : problem->resources) {
+            if (resource.max.size() != size_t(time_steps) || resource.min.size() != size_t(time_steps)) {
+                return false;
+            }
+        }
+
+        size_t schedules = 0;
+        if (problem->schedule_offset.size() != problem->interventions.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < problem->interventions.size(); i++) {
+            if (problem->interventions[i].tmax < 1 || problem->schedule_offset[i] != int(schedules)) {
+                return false;
+            }
+            schedules += problem->interventions[i].tmax;
+        }
+
+        if (problem->risk_offset.size() != schedules || problem->workload_offset.size() != schedules + 1 ||
+            problem->mean_risk.size() != schedules || problem->workload_offset[0] != 0 ||
+            problem->workload_offset[schedules] > problem->workload_data.size()) {
+            return false;
+        }
+        for (size_t k = 0; k < schedules; k++) {
+            if (problem->workload_offset[k + 1] < problem->workload_offset[k]) {
+                return false;
+            }
+        }
+
+        for (const auto& exclusion : problem->exclusions) {
+            if (exclusion.first < 0 || size_t(exclusion.first) >= problem->interventions.size() ||
+                exclusion.second < 0 || size_t(exclusion.second) >= problem->interventions.size() ||
+                exclusion.season < 0 || size_t(exclusion.season) >= problem->seasons.size()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Every start's risk rows must lie inside the risk tensor; needs the
+    // schedule tables.
+    bool ValidRisk(const Problem* problem) {
+        for (size_t i = 0; i < problem->interventions.size(); i++) {
+            for (int st = 1; st <= problem->interventions[i].tmax; st++) {
+                int end = problem->WindowEnd(i, st);
+                if (end < st) {
+                    continue;
+                }
+                size_t rows = problem->scenario_offset[end] - problem->scenario_offset[st - 1];
+                size_t offset = problem->risk_offset[problem->ScheduleIndex(i, st)];
+                if (offset > problem->risk_data.size() || rows > problem->risk_data.size() - offset) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+InstanceCache::InstanceCache(string path, string source_path) {
+    this->path = path;
+    this->source_path = source_path;
+}
+
+bool InstanceCache::SourceStat(uint64_t* size, int64_t* mtime) {
+    struct stat st;
+    if (stat(this->source_path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    *size = st.st_size;
+    *mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool InstanceCache::Load(Problem* problem) {
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!SourceStat(&source_size, &source_mtime)) {
+        return false;
+    }
+
+    int fd = open(this->path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    shared_ptr<const void> storage(mapping, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+    CacheCursor cursor(mapping, size);
+
+    Header header = cursor.Value<Header>();
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION ||
+        header.source_size != source_size || header.source_mtime != source_mtime) {
+        return false;
+    }
+
+    problem->time_steps = cursor.Value<int32_t>();
+    problem->quantile = cursor.Value<float>();
+    problem->alpha = cursor.Value<float>();
+    problem->computation_time = cursor.Value<float>();
+    problem->scenarios = cursor.Vector<int>();
+    problem->scenario_offset = cursor.Vector<size_t>();
+
+    problem->resources.resize(cursor.Value<uint64_t>());
+    for (auto& resource : problem->resources) {
+        resource.name = cursor.String();
+        resource.max = cursor.Vector<float>();
+        resource.min = cursor.Vector<float>();
+    }
+
+    problem->interventions.resize(cursor.Value<uint64_t>());
+    for (auto& intervention : problem->interventions) {
+        intervention.name = cursor.String();
+        intervention.tmax = cursor.Value<int32_t>();
+        intervention.delta = cursor.Vector<int>();
+    }
+
+    problem->seasons.resize(cursor.Value<uint64_t>());
+    for (auto& season : problem->seasons) {
+        season.name = cursor.String();
+        season.duration = cursor.Vector<int>();
+    }
+
+    problem->exclusions.resize(cursor.Value<uint64_t>());
+    for (auto& exclusion : problem->exclusions) {
+        exclusion.name = cursor.String();
+        exclusion.interventions = { cursor.String(), cursor.String() };
+        exclusion.season_name = cursor.String();
+        exclusion.first = cursor.Value<int32_t>();
+        exclusion.second = cursor.Value<int32_t>();
+        exclusion.season = cursor.Value<int32_t>();
+    }
+
+    problem->schedule_offset = cursor.Vector<int>();
+    problem->risk_offset = cursor.Vector<size_t>();
+    problem->risk_data = cursor.Array<float>(true);
+    problem->workload_offset = cursor.Vector<size_t>();
+    problem->workload_data = cursor.Array<WorkloadEntry>(true);
+    problem->mean_risk = cursor.Vector<double>();
+    problem->storage = storage;
+
+    if (cursor.failed || !ValidLayout(problem)) {
+        return false;
+    }
+
+    problem->IndexSymbols();
+    problem->IndexSchedules();
+    if (!ValidRisk(problem)) {
+        return false;
+    }
+    problem->IndexSeasons();
+    problem->IndexDomains();
+
+    return true;
+}
+
+bool InstanceCache::Write(const Problem* problem) {
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!SourceStat(&source_size, &source_mtime)) {
+        return false;
+    }
+
+    // Write next to the target and rename, so concurrent runs never map a
+    // partially written file.
+    string temp_path = this->path + ".tmp" + to_string(getpid());
+    {
+        CacheWriter writer(temp_path);
+        if (!writer.out) {
+            return false;
+        }
+
+        Header header = {};
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.source_size = source_size;
+        header.source_mtime = source_mtime;
+        writer.Value(header);
+
+        writer.Value<int32_t>(problem->time_steps);
+        writer.Value<float>(problem->quantile);
+        writer.Value<float>(problem->alpha);
+        writer.Value<float>(problem->computation_time);
+        writer.Array<int>(problem->scenarios);
+        writer.Array<size_t>(problem->scenario_offset);
+
+        writer.Value<uint64_t>(problem->resources.size());
+        for (const auto& resource : problem->resources) {
+            writer.String(resource.name);
+            writer.Array<float>(resource.max);
+            writer.Array<float>(resource.min);
+        }
+
+        writer.Value<uint64_t>(problem->interventions.size());
+        for (const auto& intervention : problem->interventions) {
+            writer.String(intervention.name);
+            writer.Value<int32_t>(intervention.tmax);
+            writer.Array<int>(intervention.delta);
+        }
+
+        writer.Value<uint64_t>(problem->seasons.size());
+        for (const auto& season : problem->seasons) {
+            writer.String(season.name);
+            writer.Array<int>(season.duration);
+        }
+
+        writer.Value<uint64_t>(problem->exclusions.size());
+        for (const auto& exclusion : problem->exclusions) {
+            writer.String(exclusion.name);
+            writer.String(exclusion.interventions[0]);
+            writer.String(exclusion.interventions[1]);
+            writer.String(exclusion.season_name);
+            writer.Value<int32_t>(exclusion.first);
+            writer.Value<int32_t>(exclusion.second);
+            writer.Value<int32_t>(exclusion.season);
+        }
+
+        writer.Array<int>(problem->schedule_offset);
+        writer.Array<size_t>(problem->risk_offset);
+        writer.Array<float>(problem->risk_data, true);
+        writer.Array<size_t>(problem->workload_offset);
+        writer.Array<WorkloadEntry>(problem->workload_data, true);
+        writer.Array<double>(problem->mean_risk);
+
+        writer.out.close();
+        if (!writer.out) {
+            remove(temp_path.c_str());
+            return false;
+        }
+    }
+
+    if (rename(temp_path.c_str(), this->path.c_str()) != 0) {
+        remove(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
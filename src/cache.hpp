@@ -0,0 +1,48 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "problem.hpp"
+
+using namespace std;
+
+const uint32_t CACHE_VERSION = 5;
+
+// Binary image of an indexed Problem. The risk tensor and the workload
+// entries are read in place from a shared read-only mapping, so every
+// process running the same instance shares those pages. The mean risk of
+// every start is stored too, so loading never has to stream the tensor.
+class InstanceCache {
+public:
+    string path;
+    string source_path;
+
+    InstanceCache(string path, string source_path);
+
+    bool Load(Problem* problem);
+    bool Write(const Problem* problem);
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t source_size;
+        // Modification time of the source in nanoseconds, so a rewrite within
+        // the same second still invalidates the cache.
+        int64_t source_mtime;
+    };
+
+    bool SourceStat(uint64_t* size, int64_t* mtime);
+};
+
+#endif
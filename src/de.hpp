@@ -6,35 +6,431 @@
 #include <random>
 #include <chrono>
 #include <vector>
-#include <functional>
+#include <span>
+#include <tuple>
+#include <concepts>
+#include <limits>
 #include <omp.h>
 #include "problem.hpp"
 #include "optimization.hpp"
+#include "fitness_cache.hpp"
+#include "genome.hpp"
+#include "repair.hpp"
+#include "violation_profile.hpp"
 
 using namespace std;
 
+// What DifferentialEvolution needs from an evaluator. Schedules are passed as
+// views, so scoring an individual never copies its genome.
+template <typename Evaluator>
+concept ScheduleEvaluator = requires(Evaluator& evaluator, span<const int> start_times, span<const span<const int>> schedules,
+    span<tuple<float, float, float>> results, span<const float> cutoffs, span<float> bounds, span<float> penalties, float penalty) {
+    { evaluator.ConstraintSatisfied(start_times) } -> same_as<tuple<bool, float>>;
+    { evaluator.ObjectiveFunction(start_times, penalty) } -> same_as<tuple<float, float, float>>;
+    { evaluator.EvaluateBatch(schedules, results, cutoffs, penalties) } -> same_as<void>;
+    { evaluator.ScreenBatch(schedules, bounds, penalties) } -> same_as<bool>;
+};
+
+// One in this many trials rejected by scenario racing is still evaluated
+// exactly, to measure how often racing rejects a trial that would have won.
+const size_t RACING_AUDIT = 32;
+// Racing is switched off for the rest of the run when, after this many
+// screened trials, it has not paid for itself.
+const size_t RACING_WARMUP = 1024;
+
+template <ScheduleEvaluator Evaluator>
 class DifferentialEvolution {
 public:
-    using ObjectiveFunc = function<tuple<float, float, float>(vector<int>, float)>;
-    using ConstraintFunc = function<tuple<bool, float>(vector<int>)>;
-    using GeneratePopulationFunc = function<vector<vector<int>>(size_t, vector<pair<int, int>>)>;
-    ObjectiveFunc objective_func;
-    ConstraintFunc constraint_func;
+    Evaluator* evaluator;
     Problem* problem;
-    vector<vector<int>> population;
+    GenomeMatrix population;
     int population_size = 10;
     vector<float> fitness;
-    vector<pair<int, int>> bounds;
     float mutation_rate = 0.6235;
     float crossover_rate = 0.5763;
+    FitnessCache cache;
+    // Applied to every generated individual and trial before it is evaluated.
+    Repair* repair = nullptr;
+    // Samples the violations of the generated schedules, before repair, and
+    // of the evaluated ones.
+    ViolationProfile* violations = nullptr;
+    // Screens trials on a sample of the scenarios before evaluating them
+    // exactly. Off by default: on A_08, the only bundled instance with enough
+    // scenarios, it has not measured faster than exact evaluation.
+    bool racing = false;
 
-    DifferentialEvolution(ObjectiveFunc objective_func, ConstraintFunc constraint_func, Problem* problem, int population_size, vector<int> gurobi_solution);
+    DifferentialEvolution(Evaluator* evaluator, Problem* problem, int population_size, vector<int> gurobi_solution,
+        Repair* repair = nullptr, ViolationProfile* violations = nullptr);
 
     vector<int> Optimize(chrono::time_point<chrono::high_resolution_clock> start_time);
 
 private:
-    vector<pair<int, int>> CreateBounds(vector<Intervention> interventions);
-    vector<vector<int>> GeneratePopulation(size_t interventions_size);
+    void GeneratePopulation(GenomeMatrix& population);
+    // Records the rows as generated, then repairs them.
+    void RepairRows(GenomeMatrix& individuals);
+    // Trials are written here and the rows that lose selection are replaced
+    // by their targets, so each generation ends by swapping the two buffers.
+    GenomeMatrix offspring;
+    // Per-thread mutant and random generator, indexed by omp_get_thread_num().
+    vector<vector<int>> mutants;
+    vector<mt19937> generators;
+    // Rows that missed the cache, gathered for one batch evaluation.
+    vector<span<const int>> pending;
+    vector<span<const int>> generated;
+    vector<size_t> pending_index;
+    vector<float> pending_cutoffs;
+    vector<float> pending_penalties;
+    vector<float> bounds;
+    vector<char> pending_audit;
+    vector<tuple<float, float, float>> results;
+    size_t evaluated = 0;
+    double evaluation_seconds = 0.0;
+    size_t screened = 0;
+    size_t rejected = 0;
+    size_t audited = 0;
+    size_t false_rejections = 0;
+    double screening_seconds = 0.0;
+    double profiling_seconds = 0.0;
+
+    vector<float> EvaluatePopulation(const GenomeMatrix& individuals, span<const float> cutoffs = {});
+    bool Screen(vector<float>& fitness);
+    double RacingSpeedup() const;
 };
 
-#endif
\ No newline at end of file
+template <ScheduleEvaluator Evaluator>
+DifferentialEvolution<Evaluator>::DifferentialEvolution(
+    Evaluator* evaluator,
+    Problem* problem,
+    int population_size,
+    vector<int> gurobi_solution,
+    Repair* repair,
+    ViolationProfile* violations) :
+    evaluator(evaluator), problem(problem), cache(problem->interventions.size()), repair(repair), violations(violations) {
+    this->population_size = population_size;
+    this->population = GenomeMatrix(population_size, this->problem->interventions.size());
+    this->offspring = GenomeMatrix(population_size, this->problem->interventions.size());
+    this->mutants.assign(omp_get_max_threads(), vector<int>(this->problem->interventions.size()));
+    random_device rd;
+    for (int k = 0; k < omp_get_max_threads(); k++) {
+        this->generators.emplace_back(rd() ^ static_cast<unsigned int>(k));
+    }
+    GeneratePopulation(this->population);
+
+    copy(gurobi_solution.begin(), gurobi_solution.end(), this->population.Row(0).begin());
+
+    this->fitness = EvaluatePopulation(this->population);
+}
+
+template <ScheduleEvaluator Evaluator>
+vector<float> DifferentialEvolution<Evaluator>::EvaluatePopulation(const GenomeMatrix& individuals, span<const float> cutoffs) {
+    vector<float> fitness(individuals.Rows());
+    vector<char> found(individuals.Rows());
+
+#pragma omp parallel for
+    for (size_t i = 0; i < individuals.Rows(); i++) {
+        float cutoff = cutoffs.empty() ? numeric_limits<float>::infinity() : cutoffs[i];
+        auto [hit, cached] = this->cache.Lookup(individuals.Row(i), cutoff);
+        found[i] = hit;
+        fitness[i] = cached;
+    }
+
+    this->pending.clear();
+    this->pending_index.clear();
+    this->pending_cutoffs.clear();
+    for (size_t i = 0; i < individuals.Rows(); i++) {
+        if (!found[i]) {
+            this->pending.push_back(individuals.Row(i));
+            this->pending_index.push_back(i);
+            this->pending_cutoffs.push_back(cutoffs.empty() ? numeric_limits<float>::infinity() : cutoffs[i]);
+        }
+    }
+
+    // Survivors of the screen keep the penalty it computed.
+    bool raced = this->racing && !cutoffs.empty() && Screen(fitness);
+
+    if (this->pending.empty()) {
+        return fitness;
+    }
+
+    auto start = chrono::steady_clock::now();
+    this->results.resize(this->pending.size());
+    this->evaluator->EvaluateBatch(this->pending, this->results, cutoffs.empty() ? span<const float>() : span<const float>(this->pending_cutoffs),
+        raced ? span<const float>(this->pending_penalties) : span<const float>());
+    this->evaluation_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    this->evaluated += this->pending.size();
+
+    if (this->violations != nullptr) {
+        auto profiling_start = chrono::steady_clock::now();
+        this->violations->Record(this->pending, ViolationProfile::Stage::Evaluated);
+        this->profiling_seconds += chrono::duration<double>(chrono::steady_clock::now() - profiling_start).count();
+    }
+
+    for (size_t k = 0; k < this->pending.size(); k++) {
+        size_t i = this->pending_index[k];
+        float objective = get<0>(this->results[k]);
+
+        // Only values below the cutoff are known to be exact.
+        this->cache.Insert(this->pending[k], objective, objective < this->pending_cutoffs[k]);
+        fitness[i] = objective;
+
+        if (raced && this->pending_audit[k]) {
+            this->audited++;
+            this->false_rejections += objective < this->pending_cutoffs[k];
+        }
+    }
+
+    if (this->racing && this->screened >= RACING_WARMUP && RacingSpeedup() < 1.0) {
+        this->racing = false;
+        utils::Log(this->problem->file_name, "Scenario racing disabled after " + to_string(this->screened) + " trials, speedup " + to_string(RacingSpeedup()) + "x");
+    }
+    return fitness;
+}
+
+// Races the pending trials on a sample of the scenarios. Those that cannot
+// plausibly beat their target are dropped from pending, apart from a few
+// audited ones, and get their bound as fitness. Returns false, leaving
+// pending as it is, when the evaluator cannot race this instance.
+template <ScheduleEvaluator Evaluator>
+bool DifferentialEvolution<Evaluator>::Screen(vector<float>& fitness) {
+    this->bounds.resize(this->pending.size());
+    this->pending_penalties.resize(this->pending.size());
+    this->pending_audit.assign(this->pending.size(), false);
+
+    auto screening_start = chrono::steady_clock::now();
+    bool raced = this->evaluator->ScreenBatch(this->pending, this->bounds, this->pending_penalties);
+    this->screening_seconds += chrono::duration<double>(chrono::steady_clock::now() - screening_start).count();
+
+    if (!raced) {
+        this->racing = false;
+        return false;
+    }
+    this->screened += this->pending.size();
+
+    size_t kept = 0;
+    for (size_t k = 0; k < this->pending.size(); k++) {
+        size_t i = this->pending_index[k];
+        bool reject = this->bounds[k] >= this->pending_cutoffs[k];
+        bool audit = reject && this->rejected++ % RACING_AUDIT == 0;
+
+        if (reject && !audit) {
+            fitness[i] = this->bounds[k];
+            continue;
+        }
+
+        this->pending[kept] = this->pending[k];
+        this->pending_index[kept] = i;
+        this->pending_cutoffs[kept] = this->pending_cutoffs[k];
+        this->pending_penalties[kept] = this->pending_penalties[k];
+        this->pending_audit[kept] = audit;
+        kept++;
+    }
+
+    this->pending.resize(kept);
+    this->pending_index.resize(kept);
+    this->pending_cutoffs.resize(kept);
+    this->pending_penalties.resize(kept);
+    this->pending_audit.resize(kept);
+    return true;
+}
+
+// Cost of evaluating every screened trial exactly, against screening them
+// plus the exact evaluations that followed.
+template <ScheduleEvaluator Evaluator>
+double DifferentialEvolution<Evaluator>::RacingSpeedup() const {
+    double average_evaluation = this->evaluated > 0 ? this->evaluation_seconds / this->evaluated : 0.0;
+    size_t survivors = this->screened - this->rejected + this->audited;
+    double raced_seconds = this->screening_seconds + survivors * average_evaluation;
+    return raced_seconds > 0.0 ? this->screened * average_evaluation / raced_seconds : 0.0;
+}
+
+template <ScheduleEvaluator Evaluator>
+void DifferentialEvolution<Evaluator>::GeneratePopulation(GenomeMatrix& population) {
+    random_device rd;
+    mt19937 gen(rd());
+
+    for (size_t i = 0; i < population.Rows(); i++) {
+        span<int> individual = population.Row(i);
+        for (size_t j = 0; j < individual.size(); j++) {
+            span<const int> domain = this->problem->Domain(j);
+            uniform_int_distribution<size_t> dist(0, domain.size() - 1);
+            individual[j] = domain[dist(gen)];
+        }
+    }
+
+    RepairRows(population);
+}
+
+template <ScheduleEvaluator Evaluator>
+void DifferentialEvolution<Evaluator>::RepairRows(GenomeMatrix& individuals) {
+    if (this->violations != nullptr) {
+        auto profiling_start = chrono::steady_clock::now();
+        this->generated.clear();
+        for (size_t i = 0; i < individuals.Rows(); i++) {
+            this->generated.push_back(individuals.Row(i));
+        }
+        this->violations->Record(this->generated, ViolationProfile::Stage::Generated);
+        this->profiling_seconds += chrono::duration<double>(chrono::steady_clock::now() - profiling_start).count();
+    }
+
+    if (this->repair != nullptr) {
+#pragma omp parallel for
+        for (size_t i = 0; i < individuals.Rows(); i++) {
+            this->repair->Apply(individuals.Row(i));
+        }
+    }
+}
+
+template <ScheduleEvaluator Evaluator>
+vector<int> DifferentialEvolution<Evaluator>::Optimize(chrono::time_point<chrono::high_resolution_clock> start_time) {
+    auto remaining_time = TIME_LIMIT - (chrono::duration_cast<chrono::seconds>(chrono::high_resolution_clock::now() - start_time).count());
+    auto search_start = chrono::steady_clock::now();
+    int iterations_without_improvement = 0;
+
+    while (remaining_time > 0) {
+        if (iterations_without_improvement > 100) {
+            //cout << "Restarting population" << endl;
+            size_t best_index = distance(this->fitness.begin(), min_element(this->fitness.begin(), this->fitness.end()));
+            float best_fitness = this->fitness[best_index];
+
+            // The best individual is kept in the spare buffer while the
+            // population is regenerated.
+            span<const int> best_solution = this->population.Row(best_index);
+            copy(best_solution.begin(), best_solution.end(), this->offspring.Row(0).begin());
+
+            GeneratePopulation(this->population);
+            this->fitness = EvaluatePopulation(this->population);
+
+            // Add the best solution to the population
+            span<const int> kept = this->offspring.Row(0);
+            copy(kept.begin(), kept.end(), this->population.Row(0).begin());
+            this->fitness[0] = best_fitness;
+
+            iterations_without_improvement = 0;
+        }
+
+        span<const int> best = this->population.Row(distance(this->fitness.begin(), min_element(this->fitness.begin(), this->fitness.end())));
+
+#pragma omp parallel for
+        for (size_t i = 0; i < this->population.Rows(); i++) {
+            int thread = omp_get_thread_num() % this->mutants.size();
+            mt19937& rng = this->generators[thread];
+            uniform_int_distribution<size_t> dist_index(0, this->population.Rows() - 1);
+            uniform_real_distribution<float> dist_real(0.0, 1.0);
+
+            span<const int> target = this->population.Row(i);
+
+            size_t x1_index = dist_index(rng);
+            size_t x2_index = dist_index(rng);
+
+            while (x1_index == i || x2_index == i || x1_index == x2_index) {
+                x1_index = dist_index(rng);
+                x2_index = dist_index(rng);
+            }
+
+            span<const int> x1 = this->population.Row(x1_index);
+            span<const int> x2 = this->population.Row(x2_index);
+
+            // Mutation (/best/1)
+            vector<int>& mutant = this->mutants[thread];
+            for (size_t j = 0; j < target.size(); j++) {
+                if (dist_real(rng) < this->mutation_rate) {
+                    int chromosome = best[j] + this->mutation_rate * (x1[j] - x2[j]);
+                    mutant[j] = this->problem->NearestStart(j, chromosome);
+                }
+                else {
+                    mutant[j] = target[j];
+                }
+            }
+
+            // Exponential Crossover (/exp), written straight into the next buffer
+            span<int> trial = this->offspring.Row(i);
+            copy(target.begin(), target.end(), trial.begin());
+            size_t j = dist_index(rng) % target.size();
+            size_t L = 0;
+            do {
+                trial[j] = mutant[j];
+                j = (j + 1) % target.size();
+                L++;
+            } while (dist_index(rng) < this->crossover_rate && L < target.size());
+        }
+
+        RepairRows(this->offspring);
+
+        // All trials of a generation are evaluated together, then selected.
+        // A trial is only kept if it beats its target, so the target's fitness
+        // is its cutoff and rejected trials are abandoned early.
+        vector<float> trial_fitness = EvaluatePopulation(this->offspring, this->fitness);
+
+        float best_fitness = *min_element(this->fitness.begin(), this->fitness.end());
+        for (size_t i = 0; i < this->population.Rows(); i++) {
+            if (trial_fitness[i] < this->fitness[i]) {
+                this->fitness[i] = trial_fitness[i];
+            }
+            else {
+                span<const int> target = this->population.Row(i);
+                copy(target.begin(), target.end(), this->offspring.Row(i).begin());
+            }
+        }
+        swap(this->population, this->offspring);
+
+        float new_best_fitness = *min_element(this->fitness.begin(), this->fitness.end());
+        cout << "Best fitness: " << setprecision(6) << new_best_fitness << fixed << "\r" << flush;
+
+        if (new_best_fitness < best_fitness) {
+            iterations_without_improvement = 0;
+        }
+        else {
+            iterations_without_improvement++;
+        }
+
+        remaining_time = TIME_LIMIT - (chrono::duration_cast<chrono::seconds>(chrono::high_resolution_clock::now() - start_time).count());
+    }
+
+    span<const int> best_row = this->population.Row(distance(this->fitness.begin(), min_element(this->fitness.begin(), this->fitness.end())));
+    vector<int> best_solution(best_row.begin(), best_row.end());
+
+    auto [violated, penalty] = this->evaluator->ConstraintSatisfied(best_solution);
+    auto [objective, mean_risk, expected_excess] = this->evaluator->ObjectiveFunction(best_solution, penalty);
+
+    ostringstream oss;
+    oss << "[";
+    for (size_t j = 0; j < best_solution.size(); ++j) {
+        oss << best_solution[j];
+        if (j < best_solution.size() - 1) oss << ", ";
+    }
+    oss << "]";
+
+    utils::Log(this->problem->file_name, "DE solution: " + oss.str());
+    utils::Log(this->problem->file_name, "Mean risk: " + to_string(mean_risk));
+    utils::Log(this->problem->file_name, "Expected excess: " + to_string(expected_excess));
+    utils::Log(this->problem->file_name, "Objective: " + to_string(objective));
+
+    size_t hits = this->cache.hits + this->cache.bound_hits;
+    size_t lookups = hits + this->cache.misses;
+    double average_evaluation = this->evaluated > 0 ? this->evaluation_seconds / this->evaluated : 0.0;
+    utils::Log(this->problem->file_name, "Fitness cache: " + to_string(hits) + "/" + to_string(lookups) + " hits (" +
+        to_string(this->cache.bound_hits) + " on bounds), hit rate " + to_string(lookups > 0 ? 100.0 * hits / lookups : 0.0) +
+        "%, saved about " + to_string(hits * average_evaluation * 1000.0) + "ms");
+
+    if (this->screened > 0) {
+        utils::Log(this->problem->file_name, "Scenario racing: " + to_string(this->rejected) + "/" + to_string(this->screened) +
+            " trials rejected, speedup " + to_string(RacingSpeedup()) + "x, false rejections " + to_string(this->false_rejections) + "/" +
+            to_string(this->audited) + " audited (" + to_string(this->audited > 0 ? 100.0 * this->false_rejections / this->audited : 0.0) + "%)");
+    }
+
+    if (this->repair != nullptr) {
+        utils::Log(this->problem->file_name, "Repair: " + to_string(this->repair->repaired) + "/" + to_string(this->repair->infeasible) +
+            " infeasible schedules made feasible, " + to_string(this->repair->moves) + " moves over " + to_string(this->repair->calls) + " calls");
+    }
+
+    if (this->violations != nullptr) {
+        double search_seconds = chrono::duration<double>(chrono::steady_clock::now() - search_start).count();
+        utils::Log(this->problem->file_name, "Violation profile: " + to_string(this->profiling_seconds * 1000.0) + "ms, " +
+            to_string(this->evaluation_seconds > 0.0 ? 100.0 * this->profiling_seconds / this->evaluation_seconds : 0.0) + "% of evaluation time, " +
+            to_string(search_seconds > 0.0 ? 100.0 * this->profiling_seconds / search_seconds : 0.0) + "% of search time");
+    }
+
+    return best_solution;
+}
+
+#endif
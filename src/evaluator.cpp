@@ -0,0 +1,209 @@
+#include "evaluator.hpp"
+
+MoveEvaluator::MoveEvaluator(Problem* problem, vector<int> start_times) : profile(problem, start_times) {
+    this->problem = problem;
+    this->start_times = start_times;
+    this->resource_violation = this->profile.Violation();
+
+    int time_steps = problem->time_steps;
+    int max_scenarios = max(1, *max_element(problem->scenarios.begin(), problem->scenarios.end()));
+    this->scenario_risk.resize(problem->scenario_offset[time_steps], 0.0);
+    this->excess.resize(time_steps, 0.0f);
+    this->overlap.resize(problem->exclusions.size(), 0);
+    this->selection.resize(max_scenarios);
+
+    for (size_t i = 0; i < problem->interventions.size(); i++) {
+        int start_time = start_times[i];
+        if (problem->ValidStart(i, start_time)) {
+            for (int t = start_time; t <= problem->WindowEnd(i, start_time); t++) {
+                AddRow(i, start_time, t, 1.0);
+            }
+            this->mean_total += problem->MeanRisk(i, start_time);
+        }
+
+        this->overflow_total += Overflow(i, start_time);
+        this->invalid_starts += Invalid(i, start_time);
+    }
+
+    for (int t = 1; t <= time_steps; t++) {
+        this->excess[t - 1] = Excess(t);
+        this->excess_total += this->excess[t - 1];
+    }
+
+    for (size_t e = 0; e < problem->exclusions.size(); e++) {
+        this->overlap[e] = ExclusionOverlap(e);
+        this->exclusion_total += this->overlap[e];
+    }
+}
+
+tuple<float, float, float, float> MoveEvaluator::Evaluate() const {
+    return Combine(this->resource_violation);
+}
+
+tuple<float, float, float, float> MoveEvaluator::Combine(double resource_violation) const {
+    float alpha = this->problem->alpha;
+    int time_steps = this->problem->time_steps;
+    float mean_risk = float(this->mean_total / time_steps);
+    float expected_excess = float(this->excess_total / time_steps);
+    float objective = alpha * mean_risk + (1 - alpha) * expected_excess;
+
+    float intervention_penalty = this->invalid_starts > 0 ? 1.0f : float(this->overflow_total);
+    float resource_penalty = float(resource_violation);
+    float exclusion_penalty = float(this->exclusion_total);
+
+    float penalty = 0.0;
+    if (intervention_penalty > 0) penalty += intervention_penalty * 1e6;
+    if (resource_penalty > 0) penalty += resource_penalty * 1e6;
+    if (exclusion_penalty > 0) penalty += exclusion_penalty * 1e6;
+
+    return make_tuple(objective + penalty, mean_risk, expected_excess, penalty);
+}
+
+tuple<float, float, float, float> MoveEvaluator::Delta(int intervention, int new_start) {
+    return Move(intervention, new_start, false);
+}
+
+tuple<float, float, float, float> MoveEvaluator::Apply(int intervention, int new_start) {
+    return Move(intervention, new_start, true);
+}
+
+tuple<float, float, float, float> MoveEvaluator::Move(int intervention, int new_start, bool commit) {
+    int old_start = this->start_times[intervention];
+    if (old_start == new_start) {
+        return Evaluate();
+    }
+
+    bool old_valid = this->problem->ValidStart(intervention, old_start);
+    bool new_valid = this->problem->ValidStart(intervention, new_start);
+    int old_end = old_valid ? this->problem->WindowEnd(intervention, old_start) : 0;
+    int new_end = new_valid ? this->problem->WindowEnd(intervention, new_start) : 0;
+
+    // Time steps covered by the old or the new window.
+    this->steps.clear();
+    for (int start : { old_start, new_start }) {
+        if (this->problem->ValidStart(intervention, start)) {
+            for (int t = start; t <= this->problem->WindowEnd(intervention, start); t++) {
+                this->steps.push_back(t);
+            }
+        }
+    }
+    sort(this->steps.begin(), this->steps.end());
+    this->steps.erase(unique(this->steps.begin(), this->steps.end()), this->steps.end());
+
+    // A trial move keeps the scenario sums and excess terms it overwrites,
+    // so that undoing it restores them exactly.
+    const vector<size_t>& scenario_offset = this->problem->scenario_offset;
+    this->saved_risk.clear();
+    this->saved_excess.clear();
+    if (!commit) {
+        for (int t : this->steps) {
+            this->saved_risk.insert(this->saved_risk.end(),
+                this->scenario_risk.begin() + scenario_offset[t - 1], this->scenario_risk.begin() + scenario_offset[t]);
+            this->saved_excess.push_back(this->excess[t - 1]);
+        }
+    }
+
+    double saved_excess_total = this->excess_total;
+    for (int t : this->steps) {
+        if (old_valid && old_start <= t && t <= old_end) {
+            AddRow(intervention, old_start, t, -1.0);
+        }
+        if (new_valid && new_start <= t && t <= new_end) {
+            AddRow(intervention, new_start, t, 1.0);
+        }
+
+        float excess_t = Excess(t);
+        this->excess_total += double(excess_t) - double(this->excess[t - 1]);
+        this->excess[t - 1] = excess_t;
+    }
+
+    double saved_mean_total = this->mean_total;
+    int saved_overflow_total = this->overflow_total;
+    int saved_exclusion_total = this->exclusion_total;
+    int saved_invalid_starts = this->invalid_starts;
+
+    this->mean_total += (new_valid ? this->problem->MeanRisk(intervention, new_start) : 0.0) -
+        (old_valid ? this->problem->MeanRisk(intervention, old_start) : 0.0);
+    this->overflow_total += Overflow(intervention, new_start) - Overflow(intervention, old_start);
+    this->invalid_starts += Invalid(intervention, new_start) - Invalid(intervention, old_start);
+
+    this->start_times[intervention] = new_start;
+    for (int e : this->problem->ExclusionsOf(intervention)) {
+        int overlap = ExclusionOverlap(e);
+        this->exclusion_total += overlap - this->overlap[e];
+        if (commit) {
+            this->overlap[e] = overlap;
+        }
+    }
+
+    // Both a trial and a committed move take the violation from
+    // MoveViolation, so they report the same result for the same move.
+    double resource_violation = this->profile.MoveViolation(intervention, old_start, new_start);
+    if (commit) {
+        this->profile.Move(intervention, old_start, new_start);
+        this->resource_violation = resource_violation;
+    }
+    tuple<float, float, float, float> result = Combine(resource_violation);
+
+    if (!commit) {
+        this->start_times[intervention] = old_start;
+        this->mean_total = saved_mean_total;
+        this->overflow_total = saved_overflow_total;
+        this->exclusion_total = saved_exclusion_total;
+        this->invalid_starts = saved_invalid_starts;
+        this->excess_total = saved_excess_total;
+        auto saved = this->saved_risk.begin();
+        for (size_t k = 0; k < this->steps.size(); k++) {
+            int t = this->steps[k];
+            size_t scenarios_t = scenario_offset[t] - scenario_offset[t - 1];
+            copy(saved, saved + scenarios_t, this->scenario_risk.begin() + scenario_offset[t - 1]);
+            saved += scenarios_t;
+            this->excess[t - 1] = this->saved_excess[k];
+        }
+    }
+
+    return result;
+}
+
+void MoveEvaluator::AddRow(int intervention, int start_time, int t, double sign) {
+    int scenarios_t = this->problem->scenarios[t - 1];
+    const float* risk_row = this->problem->RiskRow(intervention, start_time, t);
+    double* scenario_risk = &this->scenario_risk[this->problem->scenario_offset[t - 1]];
+    for (int s = 0; s < scenarios_t; s++) {
+        scenario_risk[s] += sign * risk_row[s];
+    }
+}
+
+float MoveEvaluator::Excess(int t) {
+    int scenarios_t = this->problem->scenarios[t - 1];
+    if (scenarios_t == 0) {
+        return 0.0;
+    }
+
+    // The selection reorders its input, so it runs on a copy of the sums.
+    const double* scenario_risk = &this->scenario_risk[this->problem->scenario_offset[t - 1]];
+    double risk_total = 0.0;
+    for (int s = 0; s < scenarios_t; s++) {
+        this->selection[s] = float(scenario_risk[s]);
+        risk_total += scenario_risk[s];
+    }
+
+    float risk_t = float(risk_total / scenarios_t);
+    return max(0.0f, SelectQuantile(this->selection.data(), scenarios_t, this->problem->quantile) - risk_t);
+}
+
+int MoveEvaluator::Overflow(int intervention, int start_time) const {
+    if (!this->problem->ValidStart(intervention, start_time)) {
+        return 0;
+    }
+    return max(0, this->problem->EndTime(intervention, start_time) - this->problem->time_steps);
+}
+
+int MoveEvaluator::ExclusionOverlap(int exclusion) const {
+    const Exclusion& e = this->problem->exclusions[exclusion];
+    return this->problem->ExclusionOverlap(exclusion, this->start_times[e.first], this->start_times[e.second]);
+}
+
+bool MoveEvaluator::Invalid(int intervention, int start_time) const {
+    return start_time < 0 || start_time > this->problem->interventions[intervention].tmax;
+}
@@ -0,0 +1,61 @@
+#ifndef EVALUATOR_HPP
+#define EVALUATOR_HPP
+
+#include <algorithm>
+#include <vector>
+#include <tuple>
+#include <cmath>
+#include "problem.hpp"
+#include "kernels.hpp"
+#include "resource_profile.hpp"
+
+using namespace std;
+
+// Keeps the per-(t, scenario) risk sums, the resource usage and running
+// totals of every objective and penalty term of a schedule, so that moving
+// one intervention only subtracts its old rows and adds its new ones over
+// the time steps of the two windows, and Evaluate only combines the totals.
+//
+// Sums are kept in double, so repeated moves do not drift; the results
+// agree with ObjectiveFunction and ConstraintSatisfied up to float rounding
+// of their summation order. Delta and Apply of the same move, and Evaluate
+// after that Apply, report identical values.
+class MoveEvaluator {
+public:
+    Problem* problem;
+    vector<int> start_times;
+
+    MoveEvaluator(Problem* problem, vector<int> start_times);
+
+    // (objective + penalty, mean risk, expected excess, penalty)
+    tuple<float, float, float, float> Evaluate() const;
+    tuple<float, float, float, float> Delta(int intervention, int new_start);
+    tuple<float, float, float, float> Apply(int intervention, int new_start);
+
+private:
+    vector<double> scenario_risk;
+    vector<float> excess;
+    ResourceProfile profile;
+    vector<int> overlap;
+    double mean_total = 0.0;
+    double excess_total = 0.0;
+    double resource_violation = 0.0;
+    int overflow_total = 0;
+    int exclusion_total = 0;
+    int invalid_starts = 0;
+
+    vector<int> steps;
+    vector<double> saved_risk;
+    vector<float> saved_excess;
+    vector<float> selection;
+
+    tuple<float, float, float, float> Move(int intervention, int new_start, bool commit);
+    tuple<float, float, float, float> Combine(double resource_violation) const;
+    void AddRow(int intervention, int start_time, int t, double sign);
+    float Excess(int t);
+    int Overflow(int intervention, int start_time) const;
+    int ExclusionOverlap(int exclusion) const;
+    bool Invalid(int intervention, int start_time) const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "fitness_cache.hpp"
+#include <algorithm>
+
+FitnessCache::FitnessCache(size_t schedule_size, size_t bytes) :
+    slots(max(FITNESS_CACHE_LOCKS, bytes / (schedule_size * sizeof(int) + sizeof(Slot)))),
+    locks(FITNESS_CACHE_LOCKS) {
+}
+
+uint64_t FitnessCache::Hash(span<const int> schedule) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ schedule.size();
+    for (int start_time : schedule) {
+        hash = (hash ^ static_cast<uint32_t>(start_time)) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+tuple<bool, float> FitnessCache::Lookup(span<const int> schedule, float cutoff) {
+    uint64_t hash = Hash(schedule);
+    size_t index = hash % this->slots.size();
+    lock_guard<mutex> lock(this->locks[index % this->locks.size()]);
+
+    const Slot& slot = this->slots[index];
+    if (slot.used && slot.hash == hash && equal(slot.schedule.begin(), slot.schedule.end(), schedule.begin(), schedule.end())) {
+        if (slot.exact) {
+            this->hits++;
+            return make_tuple(true, slot.fitness);
+        }
+        if (slot.fitness >= cutoff) {
+            this->bound_hits++;
+            return make_tuple(true, slot.fitness);
+        }
+    }
+
+    this->misses++;
+    return make_tuple(false, 0.0f);
+}
+
+void FitnessCache::Insert(span<const int> schedule, float fitness, bool exact) {
+    uint64_t hash = Hash(schedule);
+    size_t index = hash % this->slots.size();
+    lock_guard<mutex> lock(this->locks[index % this->locks.size()]);
+
+    Slot& slot = this->slots[index];
+    bool same = slot.used && slot.hash == hash && equal(slot.schedule.begin(), slot.schedule.end(), schedule.begin(), schedule.end());
+
+    // An exact value is never replaced by a bound on the same schedule.
+    if (same && slot.exact && !exact) {
+        return;
+    }
+
+    slot.used = true;
+    slot.exact = exact;
+    slot.hash = hash;
+    slot.fitness = fitness;
+    slot.schedule.assign(schedule.begin(), schedule.end());
+}
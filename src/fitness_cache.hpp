@@ -0,0 +1,51 @@
+#ifndef FITNESS_CACHE_HPP
+#define FITNESS_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+// Memory the cache may use for stored schedules.
+const size_t FITNESS_CACHE_BYTES = 64 * 1024 * 1024;
+const size_t FITNESS_CACHE_LOCKS = 64;
+
+// Bounded, thread-safe map from schedules to fitness. Slots are addressed by
+// a hash of the start times and hold the full schedule, which is compared on
+// lookup. A new entry replaces whatever occupied its slot.
+//
+// Entries are either exact or a lower bound, as returned by an evaluation
+// that was abandoned at a cutoff. A lower bound is only a hit when it already
+// reaches the cutoff of the lookup.
+class FitnessCache {
+public:
+    atomic<size_t> hits = 0;
+    atomic<size_t> bound_hits = 0;
+    atomic<size_t> misses = 0;
+
+    FitnessCache(size_t schedule_size, size_t bytes = FITNESS_CACHE_BYTES);
+
+    // (found, fitness)
+    tuple<bool, float> Lookup(span<const int> schedule, float cutoff);
+    void Insert(span<const int> schedule, float fitness, bool exact);
+
+private:
+    struct Slot {
+        bool used = false;
+        bool exact = false;
+        uint64_t hash = 0;
+        float fitness = 0.0;
+        vector<int> schedule;
+    };
+
+    vector<Slot> slots;
+    vector<mutex> locks;
+
+    static uint64_t Hash(span<const int> schedule);
+};
+
+#endif
@@ -0,0 +1,11 @@
+#include <algorithm>
+#include "genome.hpp"
+
+GenomeMatrix::GenomeMatrix(size_t rows, size_t columns) {
+    size_t row_ints = GENOME_ALIGNMENT / sizeof(int);
+
+    this->rows = rows;
+    this->columns = columns;
+    this->stride = (columns + row_ints - 1) / row_ints * row_ints;
+    this->data.reset(new (align_val_t(GENOME_ALIGNMENT)) int[max<size_t>(1, rows * this->stride)]());
+}
@@ -0,0 +1,39 @@
+#ifndef GENOME_HPP
+#define GENOME_HPP
+
+#include <memory>
+#include <new>
+#include <span>
+
+using namespace std;
+
+// Alignment of every genome row, in bytes.
+const size_t GENOME_ALIGNMENT = 64;
+
+// A population stored row by row in one aligned block, one row of start
+// times per individual. Rows are padded to a multiple of the alignment, so
+// each starts on its own cache line and threads filling different rows do
+// not share lines. Moving a matrix only moves the block pointer.
+class GenomeMatrix {
+public:
+    GenomeMatrix() = default;
+    GenomeMatrix(size_t rows, size_t columns);
+
+    size_t Rows() const { return this->rows; }
+    size_t Columns() const { return this->columns; }
+
+    span<int> Row(size_t row) { return span<int>(this->data.get() + row * this->stride, this->columns); }
+    span<const int> Row(size_t row) const { return span<const int>(this->data.get() + row * this->stride, this->columns); }
+
+private:
+    struct Free {
+        void operator()(int* block) const { operator delete[](block, align_val_t(GENOME_ALIGNMENT)); }
+    };
+
+    unique_ptr<int[], Free> data;
+    size_t rows = 0;
+    size_t columns = 0;
+    size_t stride = 0;
+};
+
+#endif
@@ -18,11 +18,11 @@ vector<int> Gurobi::Optimize(chrono::time_point<chrono::high_resolution_clock> s
     model.set(GRB_IntParam_PrePasses, 1);  // to not spend too much time in pre-solve
     model.set(GRB_IntParam_Method, 1);
 
-    // Create variable
+    // Create variable, only for the start times left by presolve
     map<int, map<int, GRBVar>> x;
     for (size_t i = 0; i < this->problem->interventions.size(); ++i) {
         map<int, GRBVar> temp_map;
-        for (int t = 1; t <= this->problem->time_steps; ++t) {
+        for (int t : this->problem->Domain(i)) {
             temp_map[t] = model.addVar(0.0, 1.0, 0.0, GRB_BINARY, "x_" + to_string(i) + "_" + to_string(t));
         }
         x[i] = temp_map;
@@ -30,40 +30,17 @@ vector<int> Gurobi::Optimize(chrono::time_point<chrono::high_resolution_clock> s
 
     // Set objective
     GRBLinExpr obj = 0;
-    for (int t = 1; t <= this->problem->time_steps; t++) {
-        int scenariosCount = this->problem->scenarios[t - 1];
-        for (int s = 0; s < scenariosCount; s++) {
-            for (size_t i = 0; i < this->problem->interventions.size(); i++) {
-                int tmax = this->problem->interventions[i].tmax;
-                for (int st = 1; st <= tmax; st++) {
-                    // Check if the risk data for time 't' exists
-                    auto riskTimeIt = this->problem->interventions[i].risk.find(to_string(t));
-                    if (riskTimeIt == this->problem->interventions[i].risk.end())
-                        continue;
-
-                    // Check if the risk data for start time 'st' exists
-                    auto riskStIt = riskTimeIt->second.find(to_string(st));
-                    if (riskStIt == riskTimeIt->second.end())
-                        continue;
-
-                    const vector<float>& riskVec = riskStIt->second;
-
-                    // Check that the scenario index 's' is within bounds
-                    if (s >= static_cast<int>(riskVec.size()))
-                        continue;
-
-                    double coeff = riskVec[s] / (scenariosCount * this->problem->time_steps);
-
-                    obj += coeff * x[i][st];
-                }
-            }
+    for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+        for (int st : this->problem->Domain(i)) {
+            double coeff = this->problem->MeanRisk(i, st) / this->problem->time_steps;
+            obj += coeff * x[i][st];
         }
     }
 
     // Intervention constraint
     for (size_t i = 0; i < this->problem->interventions.size(); i++) {
         GRBLinExpr expr = 0;
-        for (int t = 1; t <= this->problem->interventions[i].tmax; t++) {
+        for (int t : this->problem->Domain(i)) {
             expr += x[i][t];
         }
 
@@ -71,42 +48,44 @@ vector<int> Gurobi::Optimize(chrono::time_point<chrono::high_resolution_clock> s
     }
 
     // Resource constraint
-    for (size_t r = 0; r < this->problem->resources.size(); r++) {
-        for (int t = 1; t <= this->problem->time_steps; t++) {
-            GRBLinExpr expr = 0;
-            for (size_t i = 0; i < this->problem->interventions.size(); i++) {
-                for (int st = 1; st <= this->problem->interventions[i].tmax; st++) {
-                    if (st <= t && t <= st + this->problem->interventions[i].delta[st - 1] - 1) {
-                        expr += this->problem->interventions[i].workload[this->problem->resources[r].name][to_string(t)][to_string(st)] * x[i][st];
-                    }
-                }
+    int time_steps = this->problem->time_steps;
+    vector<GRBLinExpr> usage(this->problem->resources.size() * time_steps, 0);
+    for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+        for (int st : this->problem->Domain(i)) {
+            const WorkloadEntry* end = this->problem->WorkloadEnd(i, st);
+            for (const WorkloadEntry* entry = this->problem->WorkloadBegin(i, st); entry != end; ++entry) {
+                usage[entry->resource * time_steps + entry->t - 1] += entry->amount * x[i][st];
             }
-            model.addConstr(expr >= this->problem->resources[r].min[t - 1]);
-            model.addConstr(expr <= this->problem->resources[r].max[t - 1]);
+        }
+    }
+
+    for (size_t r = 0; r < this->problem->resources.size(); r++) {
+        for (int t = 1; t <= time_steps; t++) {
+            model.addConstr(usage[r * time_steps + t - 1] >= this->problem->resources[r].min[t - 1]);
+            model.addConstr(usage[r * time_steps + t - 1] <= this->problem->resources[r].max[t - 1]);
         }
     }
 
     // Exclusion constraint
     for (const auto& exclusion : this->problem->exclusions) {
-        auto [i1, i2, season] = make_tuple(exclusion.interventions[0], exclusion.interventions[1], exclusion.season);
-        auto it1 = find_if(this->problem->interventions.begin(), this->problem->interventions.end(), [i1](const Intervention& i) { return i.name == i1; });
-        auto it2 = find_if(this->problem->interventions.begin(), this->problem->interventions.end(), [i2](const Intervention& i) { return i.name == i2; });
-
-        for (size_t t = 0; t < season.duration.size(); t++) {
-            GRBLinExpr expr = 0;
-            for (size_t st = 1; st <= static_cast<size_t>(it1->tmax); st++) {
-                if (st <= static_cast<size_t>(season.duration[t]) && static_cast<size_t>(season.duration[t]) <= st + it1->delta[st - 1] - 1) {
-                    expr += x[distance(this->problem->interventions.begin(), it1)][st];
+        const Season& season = this->problem->seasons[exclusion.season];
+
+        vector<GRBLinExpr> overlap(time_steps + 1, 0);
+        for (int i : { exclusion.first, exclusion.second }) {
+            for (int st : this->problem->Domain(i)) {
+                int end_time = this->problem->WindowEnd(i, st);
+                for (int t = st; t <= end_time; t++) {
+                    if (this->problem->InSeason(exclusion.season, t)) {
+                        overlap[t] += x[i][st];
+                    }
                 }
             }
+        }
 
-            for (size_t st = 1; st <= static_cast<size_t>(it2->tmax); st++) {
-                if (st <= static_cast<size_t>(season.duration[t]) && static_cast<size_t>(season.duration[t]) <= st + it2->delta[st - 1] - 1) {
-                    expr += x[distance(this->problem->interventions.begin(), it2)][st];
-                }
+        for (int t : season.duration) {
+            if (1 <= t && t <= time_steps) {
+                model.addConstr(overlap[t] <= 1);
             }
-
-            model.addConstr(expr <= 1);
         }
     }
 
@@ -115,7 +94,7 @@ vector<int> Gurobi::Optimize(chrono::time_point<chrono::high_resolution_clock> s
 
     vector<int> start_times;
     for (size_t i = 0; i < this->problem->interventions.size(); i++) {
-        for (int t = 1; t <= this->problem->interventions[i].tmax; t++) {
+        for (int t : this->problem->Domain(i)) {
             if (x[i][t].get(GRB_DoubleAttr_X) > 0.5) {
                 start_times.push_back(t);
             }
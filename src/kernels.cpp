@@ -0,0 +1,233 @@
+#include "kernels.hpp"
+
+namespace {
+    // Below this size the selection finishes with nth_element.
+    const int SELECT_CUTOFF = 64;
+
+    float AccumulateScalar(float* scenario_risk, const float* risk_row, int count) {
+        float sum = 0.0;
+        for (int s = 0; s < count; s++) {
+            sum += risk_row[s];
+            scenario_risk[s] += risk_row[s];
+        }
+        return sum;
+    }
+
+    float SelectScalar(float* values, int count, int rank) {
+        nth_element(values, values + rank, values + count);
+        return values[rank];
+    }
+
+    __attribute__((target("avx2")))
+    float AccumulateAvx2(float* scenario_risk, const float* risk_row, int count) {
+        __m256 sum = _mm256_setzero_ps();
+        int s = 0;
+        for (; s + 8 <= count; s += 8) {
+            __m256 row = _mm256_loadu_ps(risk_row + s);
+            _mm256_storeu_ps(scenario_risk + s, _mm256_add_ps(_mm256_loadu_ps(scenario_risk + s), row));
+            sum = _mm256_add_ps(sum, row);
+        }
+
+        if (s < count) {
+            __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - s), lanes);
+            __m256 row = _mm256_maskload_ps(risk_row + s, mask);
+            _mm256_maskstore_ps(scenario_risk + s, mask, _mm256_add_ps(_mm256_maskload_ps(scenario_risk + s, mask), row));
+            sum = _mm256_add_ps(sum, row);
+        }
+
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+        return _mm_cvtss_f32(half);
+    }
+
+    // Permutations that pack the lanes selected by an 8-bit mask to the front.
+    struct PackTable {
+        int lanes[256][8];
+
+        PackTable() {
+            for (int mask = 0; mask < 256; mask++) {
+                int k = 0;
+                for (int lane = 0; lane < 8; lane++) {
+                    if (mask & (1 << lane)) lanes[mask][k++] = lane;
+                }
+                for (; k < 8; k++) lanes[mask][k] = 0;
+            }
+        }
+    };
+
+    const PackTable pack_table;
+
+    // Out-of-place quickselect: each pass splits the values below and above
+    // a pivot into the two halves of scratch and drops the ties.
+    __attribute__((target("avx2,popcnt")))
+    float SelectAvx2(float* values, int count, int rank, float* scratch) {
+        float* source = values;
+        while (count > SELECT_CUTOFF) {
+            float pivot = max(min(source[0], source[count / 2]), min(max(source[0], source[count / 2]), source[count - 1]));
+            float* low = scratch;
+            float* high = scratch + count + 8;
+            int n_low = 0;
+            int n_high = 0;
+
+            __m256 p = _mm256_set1_ps(pivot);
+            int s = 0;
+            for (; s + 8 <= count; s += 8) {
+                __m256 v = _mm256_loadu_ps(source + s);
+                int mask_low = _mm256_movemask_ps(_mm256_cmp_ps(v, p, _CMP_LT_OQ));
+                int mask_high = _mm256_movemask_ps(_mm256_cmp_ps(v, p, _CMP_GT_OQ));
+
+                __m256i lanes_low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pack_table.lanes[mask_low]));
+                __m256i lanes_high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pack_table.lanes[mask_high]));
+                _mm256_storeu_ps(low + n_low, _mm256_permutevar8x32_ps(v, lanes_low));
+                _mm256_storeu_ps(high + n_high, _mm256_permutevar8x32_ps(v, lanes_high));
+                n_low += _mm_popcnt_u32(mask_low);
+                n_high += _mm_popcnt_u32(mask_high);
+            }
+            for (; s < count; s++) {
+                if (source[s] < pivot) low[n_low++] = source[s];
+                else if (source[s] > pivot) high[n_high++] = source[s];
+            }
+
+            if (rank < n_low) {
+                count = n_low;
+                source = low;
+            }
+            else if (rank >= count - n_high) {
+                rank -= count - n_high;
+                count = n_high;
+                source = high;
+            }
+            else {
+                return pivot;
+            }
+
+            // Move the surviving side back so the next pass can reuse scratch.
+            memmove(values, source, count * sizeof(float));
+            source = values;
+        }
+
+        return SelectScalar(source, count, rank);
+    }
+
+    __attribute__((target("avx512f")))
+    float AccumulateAvx512(float* scenario_risk, const float* risk_row, int count) {
+        __m512 sum = _mm512_setzero_ps();
+        int s = 0;
+        for (; s + 16 <= count; s += 16) {
+            __m512 row = _mm512_loadu_ps(risk_row + s);
+            _mm512_storeu_ps(scenario_risk + s, _mm512_add_ps(_mm512_loadu_ps(scenario_risk + s), row));
+            sum = _mm512_add_ps(sum, row);
+        }
+
+        if (s < count) {
+            __mmask16 mask = static_cast<__mmask16>((1u << (count - s)) - 1);
+            __m512 row = _mm512_maskz_loadu_ps(mask, risk_row + s);
+            _mm512_mask_storeu_ps(scenario_risk + s, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, scenario_risk + s), row));
+            sum = _mm512_add_ps(sum, row);
+        }
+
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, sum);
+        for (int width = 8; width > 0; width /= 2) {
+            for (int lane = 0; lane < width; lane++) lanes[lane] += lanes[lane + width];
+        }
+        return lanes[0];
+    }
+
+    __attribute__((target("avx512f,popcnt")))
+    float SelectAvx512(float* values, int count, int rank, float* scratch) {
+        float* source = values;
+        while (count > SELECT_CUTOFF) {
+            float pivot = max(min(source[0], source[count / 2]), min(max(source[0], source[count / 2]), source[count - 1]));
+            float* low = scratch;
+            float* high = scratch + count + 8;
+            int n_low = 0;
+            int n_high = 0;
+
+            __m512 p = _mm512_set1_ps(pivot);
+            for (int s = 0; s < count; s += 16) {
+                __mmask16 tail = count - s >= 16 ? __mmask16(0xFFFF) : static_cast<__mmask16>((1u << (count - s)) - 1);
+                __m512 v = _mm512_maskz_loadu_ps(tail, source + s);
+                __mmask16 mask_low = _mm512_mask_cmp_ps_mask(tail, v, p, _CMP_LT_OQ);
+                __mmask16 mask_high = _mm512_mask_cmp_ps_mask(tail, v, p, _CMP_GT_OQ);
+
+                _mm512_mask_compressstoreu_ps(low + n_low, mask_low, v);
+                _mm512_mask_compressstoreu_ps(high + n_high, mask_high, v);
+                n_low += _mm_popcnt_u32(mask_low);
+                n_high += _mm_popcnt_u32(mask_high);
+            }
+
+            if (rank < n_low) {
+                count = n_low;
+                source = low;
+            }
+            else if (rank >= count - n_high) {
+                rank -= count - n_high;
+                count = n_high;
+                source = high;
+            }
+            else {
+                return pivot;
+            }
+
+            memmove(values, source, count * sizeof(float));
+            source = values;
+        }
+
+        return SelectScalar(source, count, rank);
+    }
+
+    enum class Isa { Scalar, Avx2, Avx512 };
+
+    Isa DetectIsa() {
+        __builtin_cpu_init();
+        Isa isa = Isa::Scalar;
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt")) isa = Isa::Avx512;
+        else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) isa = Isa::Avx2;
+
+        const char* cap = getenv("MPP_KERNELS");
+        if (cap && strcmp(cap, "scalar") == 0) isa = Isa::Scalar;
+        else if (cap && strcmp(cap, "avx2") == 0 && isa == Isa::Avx512) isa = Isa::Avx2;
+
+        return isa;
+    }
+
+    const Isa isa = DetectIsa();
+}
+
+float AccumulateRisk(float* scenario_risk, const float* risk_row, int count) {
+    if (count < 8) {
+        return AccumulateScalar(scenario_risk, risk_row, count);
+    }
+
+    switch (isa) {
+    case Isa::Avx512: return AccumulateAvx512(scenario_risk, risk_row, count);
+    case Isa::Avx2: return AccumulateAvx2(scenario_risk, risk_row, count);
+    default: return AccumulateScalar(scenario_risk, risk_row, count);
+    }
+}
+
+float SelectQuantile(float* values, int count, float quantile) {
+    int quantile_index = int(ceil(quantile * count)) - 1;
+    if (isa == Isa::Scalar || count <= SELECT_CUTOFF) {
+        return SelectScalar(values, count, quantile_index);
+    }
+
+    thread_local vector<float> scratch;
+    scratch.resize(2 * (count + 8));
+
+    if (isa == Isa::Avx512) {
+        return SelectAvx512(values, count, quantile_index, scratch.data());
+    }
+    return SelectAvx2(values, count, quantile_index, scratch.data());
+}
+
+const char* KernelName() {
+    switch (isa) {
+    case Isa::Avx512: return "avx512";
+    case Isa::Avx2: return "avx2";
+    default: return "scalar";
+    }
+}
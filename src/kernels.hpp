@@ -0,0 +1,25 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <immintrin.h>
+
+using namespace std;
+
+// Adds risk_row into scenario_risk element-wise and returns the sum of
+// risk_row[0, count).
+float AccumulateRisk(float* scenario_risk, const float* risk_row, int count);
+
+// Value of rank ceil(quantile * count) - 1 among values[0, count), as it
+// would appear after sorting. values may be reordered.
+float SelectQuantile(float* values, int count, float quantile);
+
+// Instruction set picked at startup: "avx512", "avx2" or "scalar". Setting
+// MPP_KERNELS to one of these names caps the choice.
+const char* KernelName();
+
+#endif
@@ -0,0 +1,86 @@
+#include "loader.hpp"
+
+bool ParseLoader(const string& name, LoadOptions& options) {
+    if (name != "sax" && name != "dom" && name != "sax-mmap" && name != "dom-mmap") {
+        return false;
+    }
+
+    options.streaming_load = name.starts_with("sax");
+    options.mapped_input = name.ends_with("-mmap");
+    return true;
+}
+
+string LoaderName(const LoadOptions& options) {
+    return string(options.streaming_load ? "sax" : "dom") + (options.mapped_input ? "-mmap" : "");
+}
+
+LoadOptions LoadOptionsFromEnvironment() {
+    LoadOptions options;
+
+    const char* loader = getenv("MPP_LOADER");
+    if (loader && !ParseLoader(loader, options)) {
+        cerr << "Unknown MPP_LOADER " << loader << ", using " << LoaderName(options) << "." << endl;
+    }
+
+    const char* cache = getenv("MPP_CACHE");
+    if (cache && string(cache) == "0") {
+        options.use_cache = false;
+    }
+
+    return options;
+}
+
+rapidjson::ParseResult ReadInstance(Problem* problem, string input_file, const LoadOptions& options) {
+    if (options.mapped_input) {
+        utils::MappedFile file(input_file);
+
+        if (!file.IsOpen()) {
+            utils::Log(problem->file_name, "Error: Could not open file.");
+            exit(1);
+        }
+
+        if (options.streaming_load) {
+            InstanceReader reader(problem);
+            return reader.ReadInsitu(file.data);
+        }
+
+        rapidjson::Document doc;
+        doc.ParseInsitu(file.data);
+
+        if (!doc.HasParseError()) {
+            *problem = Problem(&doc, problem->file_name);
+        }
+
+        return rapidjson::ParseResult(doc.GetParseError(), doc.GetErrorOffset());
+    }
+
+    FILE* fp = fopen(input_file.c_str(), "r");
+
+    if (!fp) {
+        utils::Log(problem->file_name, "Error: Could not open file.");
+        exit(1);
+    }
+
+    rapidjson::ParseResult result;
+    if (options.streaming_load) {
+        InstanceReader reader(problem);
+        result = reader.Read(fp);
+    }
+    else {
+        char readBuffer[65536];
+        rapidjson::FileReadStream is(fp, readBuffer, sizeof(readBuffer));
+
+        rapidjson::Document doc;
+        doc.ParseStream(is);
+
+        if (!doc.HasParseError()) {
+            *problem = Problem(&doc, problem->file_name);
+        }
+
+        result = rapidjson::ParseResult(doc.GetParseError(), doc.GetErrorOffset());
+    }
+
+    fclose(fp);
+
+    return result;
+}
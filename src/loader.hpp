@@ -0,0 +1,38 @@
+#ifndef LOADER_HPP
+#define LOADER_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../rapidjson/document.h"
+#include "../rapidjson/filereadstream.h"
+#include "problem.hpp"
+#include "reader.hpp"
+#include "../utils/log.hpp"
+#include "../utils/mapped_file.hpp"
+
+using namespace std;
+
+// How an instance is read from its JSON file: streamed through the SAX
+// InstanceReader or parsed into a DOM, from a buffered file stream or in
+// situ from a private mapping of the file. The binary cache, when used, is
+// tried before any of them.
+struct LoadOptions {
+    bool streaming_load = true;
+    bool mapped_input = false;
+    bool use_cache = true;
+};
+
+// Loader names: "sax", "dom", "sax-mmap" and "dom-mmap". Returns false,
+// leaving options as they are, for any other name.
+bool ParseLoader(const string& name, LoadOptions& options);
+string LoaderName(const LoadOptions& options);
+
+// Options picked at runtime: MPP_LOADER names the loader, "sax" by default,
+// and MPP_CACHE=0 skips the binary cache.
+LoadOptions LoadOptionsFromEnvironment();
+
+rapidjson::ParseResult ReadInstance(Problem* problem, string input_file, const LoadOptions& options);
+
+#endif
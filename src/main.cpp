@@ -3,13 +3,15 @@
 #include <fstream>
 #include <filesystem>
 #include <chrono>
-#include "../rapidjson/document.h"
-#include "../rapidjson/filereadstream.h"
+#include <omp.h>
 #include "problem.hpp"
+#include "loader.hpp"
+#include "cache.hpp"
 #include "optimization.hpp"
 #include "../utils/log.hpp"
+#include "../utils/memory.hpp"
 
-void MakeOptimization(std::string instance) {
+void MakeOptimization(std::string instance, const LoadOptions& options) {
     cout << "Running instance " << instance << endl;
 
     auto start_time = std::chrono::high_resolution_clock::now();
@@ -22,33 +24,36 @@ void MakeOptimization(std::string instance) {
     utils::Log(instance, "Starting at " + formatted_time);
 
     // Load the problem
-    FILE* fp = fopen(("input/" + instance + ".json").c_str(), "r");
+    std::string input_file = "input/" + instance + ".json";
+    InstanceCache cache("cache/" + instance + ".bin", input_file);
+    std::string loader = "cache";
 
-    if (!fp) {
-        utils::Log(instance, "Error: Could not open file.");
-        exit(1);
-    }
+    Problem problem = Problem(instance);
 
-    char readBuffer[65536];
-    rapidjson::FileReadStream is(fp, readBuffer, sizeof(readBuffer));
+    if (!options.use_cache || !cache.Load(&problem)) {
+        problem = Problem(instance);
+        loader = string(options.streaming_load ? "SAX" : "DOM") + (options.mapped_input ? " (mmap, in situ)" : "");
 
-    rapidjson::Document doc;
-    doc.ParseStream(is);
+        rapidjson::ParseResult result = ReadInstance(&problem, input_file, options);
 
-    fclose(fp);
+        if (!result) {
+            utils::Log(instance, "Error: Could not parse JSON.");
+            utils::Log(instance, "Error code: " + to_string(result.Code()));
+            exit(1);
+        }
 
-    if (doc.HasParseError()) {
-        utils::Log(instance, "Error: Could not parse JSON.");
-        utils::Log(instance, "Error code: " + to_string(doc.GetParseError()));
-        exit(1);
+        if (options.use_cache && !cache.Write(&problem)) {
+            utils::Log(instance, "Warning: Could not write " + cache.path);
+        }
     }
 
-    Problem problem = Problem(&doc, instance);
-
     auto elapsed_time = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - start_time).count();
 
     utils::Log(instance, "Problem loaded successfully!");
+    utils::Log(instance, "Loader: " + loader);
     utils::Log(instance, "Elapsed time: " + to_string(elapsed_time) + "ms");
+    utils::Log(instance, "Peak memory: " + to_string(utils::PeakMemory()) + "KB");
+    utils::Log(instance, string("Kernels: ") + KernelName());
 
     // Optimization Step
     Optimization optimization = Optimization(&problem);
@@ -70,15 +75,20 @@ void MakeOptimization(std::string instance) {
     output_file.close();
 }
 
-void RunAllInstances(std::vector<std::string> instances) {
+void RunAllInstances(std::vector<std::string> instances, const LoadOptions& options) {
     sort(instances.begin(), instances.end());
     for (const auto& instance : instances) {
-        MakeOptimization(instance);
+        MakeOptimization(instance, options);
     }
 }
 
 int main() {
+    // EvaluateBatch may split the time steps of each individual over threads
+    // inside its parallel loop over individuals.
+    omp_set_max_active_levels(2);
+
     bool run_all = false;
+    LoadOptions options = LoadOptionsFromEnvironment();
     std::string input_path = "input/";
     std::string instance = "";
     std::vector<std::string> instances;
@@ -89,11 +99,11 @@ int main() {
     }
 
     if (run_all) {
-        RunAllInstances(instances);
+        RunAllInstances(instances, options);
     }
     else {
         instance = "A_09";
-        MakeOptimization(instance);
+        MakeOptimization(instance, options);
     }
 
     return 0;
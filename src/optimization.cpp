@@ -1,7 +1,56 @@
 #include "optimization.hpp"
+#include "de.hpp"
 
 Optimization::Optimization(Problem* problem) {
     this->problem = problem;
+
+    int time_steps = this->problem->time_steps;
+
+    this->scratch.resize(omp_get_max_threads());
+    for (auto& scratch : this->scratch) {
+        scratch.risk_by_scenario.resize(this->problem->scenario_offset[time_steps]);
+        scratch.risk_total.resize(time_steps);
+        scratch.step_excess.resize(time_steps);
+        scratch.resource_usage.resize(this->problem->resources.size() * time_steps);
+        scratch.resource_penalty.resize(this->problem->resources.size() * time_steps);
+    }
+
+    IndexSamples();
+}
+
+void Optimization::IndexSamples() {
+    int time_steps = this->problem->time_steps;
+    const vector<int>& scenarios = this->problem->scenarios;
+
+    size_t total_scenarios = this->problem->scenario_offset[time_steps];
+    this->racing = time_steps > 0 && total_scenarios >= size_t(RACING_MIN_SCENARIOS) * time_steps;
+    if (!this->racing) {
+        return;
+    }
+
+    // Blocks are spread evenly over each time step, so every part of the
+    // scenario range is represented in the sample.
+    this->sample_block_offset.assign(1, 0);
+    this->sample_offset.assign(1, 0);
+    for (int t = 1; t <= time_steps; t++) {
+        int blocks = (scenarios[t - 1] + RACING_BLOCK - 1) / RACING_BLOCK;
+        int step = max(1, blocks * RACING_BLOCK / RACING_SAMPLES);
+        size_t samples = 0;
+        for (int block = 0; block < blocks; block += step) {
+            this->sample_block.push_back(block * RACING_BLOCK);
+            samples += min(RACING_BLOCK, scenarios[t - 1] - block * RACING_BLOCK);
+        }
+        this->sample_block_offset.push_back(this->sample_block.size());
+        this->sample_offset.push_back(this->sample_offset.back() + samples);
+    }
+
+    for (auto& scratch : this->scratch) {
+        scratch.sample_risk.resize(this->sample_offset[time_steps]);
+    }
+}
+
+EvaluationScratch& Optimization::Scratch() {
+    return this->scratch[omp_get_thread_num() % this->scratch.size()];
 }
 
 vector<pair<string, int>> Optimization::OptimizationStep(chrono::time_point<chrono::high_resolution_clock> start_time) {
@@ -45,6 +94,7 @@ vector<pair<string, int>> Optimization::OptimizationStep(chrono::time_point<chro
     vector<pair<string, int>> solution;
     vector<int> populations = { 10, 20, 30 };
     int number_iterations = 20;
+    const char* racing = getenv("MPP_RACING");
 
     for (size_t i = 0; i < populations.size(); i++) {
         utils::Log(this->problem->file_name, "\nPopulation size: " + to_string(populations[i]));
@@ -55,15 +105,20 @@ vector<pair<string, int>> Optimization::OptimizationStep(chrono::time_point<chro
             solution = std::vector<pair<string, int>>();
             start_time = std::chrono::high_resolution_clock::now();
 
-            DifferentialEvolution de(
-                [this](vector<int> start_times, float penalty) { return this->ObjectiveFunction(start_times, penalty); },
-                [this](vector<int> start_times) { return this->ConstraintSatisfied(start_times); },
+            Repair repair(this->problem);
+            ViolationProfile violations(this->problem);
+            DifferentialEvolution<Optimization> de(
+                this,
                 this->problem,
                 populations[i],
-                gurobi_solution
+                gurobi_solution,
+                &repair,
+                &violations
             );
+            de.racing = racing && strcmp(racing, "1") == 0;
 
             vector<int> best_solution = de.Optimize(start_time);
+            violations.Write(i * number_iterations + j);
 
             for (size_t k = 0; k < best_solution.size(); k++) {
                 solution.push_back(make_pair(this->problem->interventions[k].name, best_solution[k]));
@@ -80,63 +135,315 @@ void Optimization::PrintSolution(vector<pair<string, int>> solution) {
     }
 }
 
-tuple<float, float, float> Optimization::ObjectiveFunction(vector<int> start_times, float penalty) {
+tuple<float, float, float> Optimization::ObjectiveFunction(span<const int> start_times, float penalty) {
+    return Objective(start_times, penalty, StepThreads(1));
+}
+
+tuple<float, float, float> Optimization::Objective(span<const int> start_times, float penalty, int threads) {
     float quantile = this->problem->quantile;
-    float alpha = this->problem->alpha;
-    float mean_risk = 0.0;
     float expected_excess = 0.0;
+    int time_steps = this->problem->time_steps;
+    const vector<size_t>& scenario_offset = this->problem->scenario_offset;
+
+    EvaluationScratch& scratch = Scratch();
+    vector<float>& risk_by_scenario = scratch.risk_by_scenario;
+    vector<float>& risk_total = scratch.risk_total;
+    vector<float>& step_excess = scratch.step_excess;
+
+    // Mean risk comes from the precomputed table; only the excess over the
+    // quantile needs the individual scenarios. Each thread owns a contiguous
+    // range of time steps, and the per-step terms are summed afterwards in
+    // time order, so the result does not depend on the number of threads.
+#pragma omp parallel num_threads(threads) if (threads > 1)
+    {
+        auto [first, last] = StepRange(omp_get_thread_num(), omp_get_num_threads());
+
+        fill(risk_by_scenario.begin() + scenario_offset[first - 1], risk_by_scenario.begin() + scenario_offset[last], 0.0f);
+        fill(risk_total.begin() + first - 1, risk_total.begin() + last, 0.0f);
+
+        for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+            int start_time = start_times[i];
+            if (!this->problem->ValidStart(i, start_time)) {
+                continue;
+            }
 
-    for (int t = 1; t < this->problem->time_steps + 1; t++) {
-        float risk_t = 0.0;
-        vector<float> risk_by_scenario;
+            int begin_time = max(start_time, first);
+            int end_time = min(this->problem->WindowEnd(i, start_time), last);
+            if (begin_time > end_time) {
+                continue;
+            }
 
-        for (long unsigned int i = 0; i < this->problem->interventions.size(); i++) {
-            int start_time = start_times[i];
-            if (start_time <= t && t <= start_time + this->problem->interventions[i].delta[start_time - 1] - 1) {
-                for (long unsigned int s = 0; s < static_cast<size_t>(this->problem->scenarios[t - 1]); s++) {
-                    float risk_value = 0.0;
-
-                    auto t_it = this->problem->interventions[i].risk.find(to_string(t));
-                    if (t_it != this->problem->interventions[i].risk.end()) {
-                        auto start_it = t_it->second.find(to_string(start_time));
-                        if (start_it != t_it->second.end() && s < start_it->second.size()) {
-                            risk_value = start_it->second[s];
-                        }
-                    }
-
-                    risk_t += risk_value;
-
-                    if (s >= risk_by_scenario.size()) {
-                        risk_by_scenario.push_back(risk_value);
-                    }
-                    else {
-                        risk_by_scenario[s] += risk_value;
-                    }
-                }
+            const float* risk_row = this->problem->RiskRow(i, start_time, begin_time);
+            for (int t = begin_time; t <= end_time; t++) {
+                float* scenario_risk = &risk_by_scenario[scenario_offset[t - 1]];
+                size_t scenarios_t = static_cast<size_t>(this->problem->scenarios[t - 1]);
+                risk_total[t - 1] += AccumulateRisk(scenario_risk, risk_row, scenarios_t);
+                risk_row += scenarios_t;
             }
         }
-        risk_t /= max(1, this->problem->scenarios[t - 1]);
-        mean_risk += risk_t;
 
-        sort(risk_by_scenario.begin(), risk_by_scenario.end());
+        for (int t = first; t <= last; t++) {
+            int scenarios_t = this->problem->scenarios[t - 1];
+            float risk_t = risk_total[t - 1] / max(1, scenarios_t);
 
-        float excess_t = 0.0;
-        if (!risk_by_scenario.empty()) {
-            int quantile_index = int(ceil(quantile * risk_by_scenario.size())) - 1;
-            excess_t = max(0.0f, risk_by_scenario[quantile_index] - risk_t);
+            float excess_t = 0.0;
+            if (scenarios_t > 0) {
+                float* scenario_risk = &risk_by_scenario[scenario_offset[t - 1]];
+                excess_t = max(0.0f, SelectQuantile(scenario_risk, scenarios_t, quantile) - risk_t);
+            }
+
+            step_excess[t - 1] = excess_t;
         }
+    }
+
+    for (int t = 1; t <= time_steps; t++) {
+        expected_excess += step_excess[t - 1];
+    }
+
+    float mean_risk = this->problem->MeanRisk(start_times);
+    return make_tuple(PartialObjective(mean_risk, expected_excess, penalty), mean_risk, expected_excess / time_steps);
+}
+
+int Optimization::StepThreads(size_t individuals) const {
+    if (omp_in_parallel()) {
+        return 1;
+    }
+
+    // Flat parallelism over individuals already keeps every thread busy.
+    // Otherwise the spare threads split the time steps of each individual,
+    // as long as each of them gets STEP_CHUNK_MIN steps.
+    int threads = omp_get_max_threads();
+    if (individuals >= size_t(threads)) {
+        return 1;
+    }
 
+    int step_threads = threads / max(size_t(1), individuals);
+    return max(1, min(step_threads, this->problem->time_steps / STEP_CHUNK_MIN));
+}
+
+pair<int, int> Optimization::StepRange(int thread, int threads) const {
+    int time_steps = this->problem->time_steps;
+    int first = 1 + int(long(time_steps) * thread / threads);
+    int last = int(long(time_steps) * (thread + 1) / threads);
+    return make_pair(first, last);
+}
+
+tuple<float, float, float> Optimization::Evaluate(span<const int> start_times, float cutoff, float penalty) {
+    float quantile = this->problem->quantile;
+    int time_steps = this->problem->time_steps;
+    size_t resources = this->problem->resources.size();
+    const vector<size_t>& scenario_offset = this->problem->scenario_offset;
+
+    // Overflows, exclusions and mean risk come from precomputed tables: a
+    // trial that already reaches its cutoff with them is rejected without
+    // touching the risk tensor. A known penalty skips the constraints.
+    bool known_penalty = penalty >= 0;
+    float intervention_violation = 0.0;
+    float exclusion_violation = 0.0;
+    if (!known_penalty) {
+        intervention_violation = get<1>(InterventionConstraint(start_times));
+        exclusion_violation = get<1>(ExclusionConstraint(start_times));
+        penalty = Penalty(intervention_violation, 0.0, exclusion_violation);
+    }
+    float mean_risk = this->problem->MeanRisk(start_times);
+    if (PartialObjective(mean_risk, 0.0, penalty) >= cutoff) {
+        return make_tuple(PartialObjective(mean_risk, 0.0, penalty), mean_risk, 0.0f);
+    }
+
+    EvaluationScratch& scratch = Scratch();
+    vector<float>& risk_by_scenario = scratch.risk_by_scenario;
+    vector<float>& risk_total = scratch.risk_total;
+    vector<float>& resource_usage = scratch.resource_usage;
+    fill(risk_by_scenario.begin(), risk_by_scenario.end(), 0.0f);
+    fill(risk_total.begin(), risk_total.end(), 0.0f);
+    if (!known_penalty) {
+        fill(resource_usage.begin(), resource_usage.end(), 0.0f);
+    }
+
+    // One walk over each intervention's window collects its scenario risk
+    // and its workload, in the order Objective and ResourceConstraint add them.
+    for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+        int start_time = start_times[i];
+        if (!this->problem->ValidStart(i, start_time)) {
+            continue;
+        }
+
+        const float* risk_row = this->problem->RiskRow(i, start_time, start_time);
+        for (int t = start_time; t <= this->problem->WindowEnd(i, start_time); t++) {
+            float* scenario_risk = &risk_by_scenario[scenario_offset[t - 1]];
+            size_t scenarios_t = static_cast<size_t>(this->problem->scenarios[t - 1]);
+            risk_total[t - 1] += AccumulateRisk(scenario_risk, risk_row, scenarios_t);
+            risk_row += scenarios_t;
+        }
+
+        if (!known_penalty) {
+            const WorkloadEntry* end = this->problem->WorkloadEnd(i, start_time);
+            for (const WorkloadEntry* entry = this->problem->WorkloadBegin(i, start_time); entry != end; ++entry) {
+                resource_usage[entry->resource * time_steps + entry->t - 1] += entry->amount;
+            }
+        }
+    }
+
+    float expected_excess = 0.0;
+    float resource_violation = 0.0;
+    for (int t = 1; t <= time_steps; t++) {
+        int scenarios_t = this->problem->scenarios[t - 1];
+        float risk_t = risk_total[t - 1] / max(1, scenarios_t);
+
+        float excess_t = 0.0;
+        if (scenarios_t > 0) {
+            float* scenario_risk = &risk_by_scenario[scenario_offset[t - 1]];
+            excess_t = max(0.0f, SelectQuantile(scenario_risk, scenarios_t, quantile) - risk_t);
+        }
         expected_excess += excess_t;
+
+        if (!known_penalty) {
+            for (size_t r = 0; r < resources; r++) {
+                resource_violation += this->problem->ResourceViolation(r, t, resource_usage[r * time_steps + t - 1]);
+            }
+            penalty = Penalty(intervention_violation, resource_violation, exclusion_violation);
+        }
+
+        // Both sums only grow, so the objective built from them so far is a
+        // lower bound on the final one.
+        if (PartialObjective(mean_risk, expected_excess, penalty) >= cutoff) {
+            break;
+        }
     }
 
-    mean_risk /= this->problem->time_steps;
-    expected_excess /= this->problem->time_steps;
-    float objective = alpha * mean_risk + (1 - alpha) * expected_excess;
+    return make_tuple(PartialObjective(mean_risk, expected_excess, penalty), mean_risk, expected_excess / time_steps);
+}
 
-    return make_tuple(objective + penalty, mean_risk, expected_excess);
+float Optimization::PartialObjective(float mean_risk, float expected_excess, float penalty) const {
+    int time_steps = this->problem->time_steps;
+    float alpha = this->problem->alpha;
+    float excess = expected_excess / time_steps;
+    float objective = alpha * mean_risk + (1 - alpha) * excess;
+    return objective + penalty;
 }
 
-tuple<bool, float> Optimization::InterventionConstraint(vector<int> start_times) {
+void Optimization::EvaluateBatch(span<const span<const int>> schedules, span<tuple<float, float, float>> results,
+    span<const float> cutoffs, span<const float> penalties) {
+    size_t batch_size = schedules.size();
+    if (batch_size == 0) {
+        return;
+    }
+
+    // With fewer individuals than threads, each individual has its time
+    // steps split over the spare threads instead.
+    int step_threads = StepThreads(batch_size);
+    if (step_threads > 1) {
+        // Individuals only run side by side when nested parallelism is
+        // enabled, as main() does; otherwise they are evaluated one after
+        // the other.
+        int outer_threads = omp_get_max_active_levels() > 1 ? max(1, omp_get_max_threads() / step_threads) : 1;
+
+#pragma omp parallel for num_threads(outer_threads) schedule(dynamic) if (outer_threads > 1)
+        for (size_t b = 0; b < batch_size; b++) {
+            float cutoff = cutoffs.empty() ? numeric_limits<float>::infinity() : cutoffs[b];
+            float penalty = penalties.empty() ? get<1>(Constraints(schedules[b], step_threads)) : penalties[b];
+            if (PartialObjective(this->problem->MeanRisk(schedules[b]), 0.0, penalty) >= cutoff) {
+                float mean_risk = this->problem->MeanRisk(schedules[b]);
+                results[b] = make_tuple(PartialObjective(mean_risk, 0.0, penalty), mean_risk, 0.0f);
+                continue;
+            }
+            results[b] = Objective(schedules[b], penalty, step_threads);
+        }
+
+        return;
+    }
+
+    // Otherwise each thread evaluates whole individuals in a single pass.
+#pragma omp parallel for schedule(dynamic)
+    for (size_t b = 0; b < batch_size; b++) {
+        float cutoff = cutoffs.empty() ? numeric_limits<float>::infinity() : cutoffs[b];
+        results[b] = Evaluate(schedules[b], cutoff, penalties.empty() ? -1.0f : penalties[b]);
+    }
+}
+
+bool Optimization::ScreenBatch(span<const span<const int>> schedules, span<float> bounds, span<float> penalties) {
+    if (!this->racing) {
+        return false;
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t b = 0; b < schedules.size(); b++) {
+        tie(bounds[b], penalties[b]) = ScreenObjective(schedules[b]);
+    }
+
+    return true;
+}
+
+tuple<float, float> Optimization::ScreenObjective(span<const int> start_times) {
+    double quantile = this->problem->quantile;
+    float alpha = this->problem->alpha;
+    int time_steps = this->problem->time_steps;
+    const vector<int>& scenarios = this->problem->scenarios;
+
+    vector<float>& sample_risk = Scratch().sample_risk;
+    fill(sample_risk.begin(), sample_risk.end(), 0.0f);
+
+    for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+        int start_time = start_times[i];
+        if (!this->problem->ValidStart(i, start_time)) {
+            continue;
+        }
+
+        for (int t = start_time; t <= this->problem->WindowEnd(i, start_time); t++) {
+            const float* risk_row = this->problem->RiskRow(i, start_time, t);
+            float* sample = &sample_risk[this->sample_offset[t - 1]];
+            for (size_t k = this->sample_block_offset[t - 1]; k < this->sample_block_offset[t]; k++) {
+                int first = this->sample_block[k];
+                int count = min(RACING_BLOCK, scenarios[t - 1] - first);
+                AccumulateRisk(sample, risk_row + first, count);
+                sample += count;
+            }
+        }
+    }
+
+    // The quantile is replaced by a distribution-free lower confidence bound,
+    // the sample order statistic RACING_Z standard deviations of a binomial
+    // below its rank. The variance of the sampled means, with the finite
+    // population correction, bounds the error of the per-step means used in
+    // the excess terms. The mean risk term itself is exact.
+    double expected_excess = 0.0;
+    double variance = 0.0;
+    for (int t = 1; t <= time_steps; t++) {
+        float* sample = &sample_risk[this->sample_offset[t - 1]];
+        int samples = this->sample_offset[t] - this->sample_offset[t - 1];
+        if (samples == 0) {
+            continue;
+        }
+
+        double sum = 0.0;
+        double sum_squares = 0.0;
+        for (int k = 0; k < samples; k++) {
+            sum += sample[k];
+            sum_squares += double(sample[k]) * sample[k];
+        }
+
+        double mean_t = sum / samples;
+        if (samples > 1) {
+            double variance_t = max(0.0, (sum_squares - sum * mean_t) / (samples - 1));
+            variance += variance_t / samples * (1.0 - double(samples) / scenarios[t - 1]);
+        }
+
+        double rank = ceil(quantile * samples) - 1 - RACING_Z * sqrt(samples * quantile * (1 - quantile));
+        if (rank >= 0) {
+            int low = int(rank);
+            nth_element(sample, sample + low, sample + samples);
+            expected_excess += max(0.0, sample[low] - mean_t);
+        }
+    }
+
+    auto [violated, penalty] = Constraints(start_times, 1);
+    double estimate = alpha * this->problem->MeanRisk(start_times) + (1 - alpha) * expected_excess / time_steps;
+    double margin = (1 - alpha) * RACING_Z * sqrt(variance) / time_steps;
+
+    return make_tuple(float(estimate - margin) + penalty, penalty);
+}
+
+tuple<bool, float> Optimization::InterventionConstraint(span<const int> start_times) {
     float penalty = 0.0;
 
     for (long unsigned int i = 0; i < start_times.size(); i++) {
@@ -146,9 +453,8 @@ tuple<bool, float> Optimization::InterventionConstraint(vector<int> start_times)
             return make_tuple(true, 1.0);
         }
 
-        if (start_time > 0 && start_time <= long(size(this->problem->interventions[i].delta))) {
-            int duration = this->problem->interventions[i].delta[start_time - 1];
-            int end_time = start_time + duration - 1;
+        if (start_time > 0) {
+            int end_time = this->problem->EndTime(i, start_time);
 
             if (end_time > this->problem->time_steps) {
                 penalty += float(end_time - this->problem->time_steps);
@@ -159,101 +465,88 @@ tuple<bool, float> Optimization::InterventionConstraint(vector<int> start_times)
     return make_tuple(penalty > 0, penalty);
 }
 
-tuple<bool, float> Optimization::ResourceConstraint(vector<int> start_times) {
+tuple<bool, float> Optimization::ResourceConstraint(span<const int> start_times, int threads) {
     float penalty = 0.0;
-    float eps = 1e-6;
-
-    for (int t = 1; t <= this->problem->time_steps; t++) {
-        for (const auto& resource : this->problem->resources) {
-            float total_resource_usage = 0.0;
-            for (size_t i = 0; i < this->problem->interventions.size(); i++) {
-                const auto& intervention = this->problem->interventions[i];
-                int start_time = start_times[i];
-                if (start_time <= t && t <= start_time + intervention.delta[start_time - 1] - 1) {
-                    // Access workload safely
-                    auto resource_it = intervention.workload.find(resource.name);
-                    if (resource_it != intervention.workload.end()) {
-                        auto t_it = resource_it->second.find(to_string(t));
-                        if (t_it != resource_it->second.end()) {
-                            auto start_it = t_it->second.find(to_string(start_time));
-                            if (start_it != t_it->second.end()) {
-                                total_resource_usage += start_it->second;
-                            }
-                        }
-                    }
-                }
+    int time_steps = this->problem->time_steps;
+    size_t resources = this->problem->resources.size();
+
+    EvaluationScratch& scratch = Scratch();
+    vector<float>& resource_usage = scratch.resource_usage;
+    vector<float>& resource_penalty = scratch.resource_penalty;
+
+#pragma omp parallel num_threads(threads) if (threads > 1)
+    {
+        auto [first, last] = StepRange(omp_get_thread_num(), omp_get_num_threads());
+
+        for (size_t r = 0; r < resources; r++) {
+            fill(resource_usage.begin() + r * time_steps + first - 1, resource_usage.begin() + r * time_steps + last, 0.0f);
+        }
+
+        for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+            if (!this->problem->ValidStart(i, start_times[i])) {
+                continue;
             }
 
-            if (total_resource_usage < resource.min[t - 1] - eps) {
-                penalty += (resource.min[t - 1] - total_resource_usage);
+            // Entries are sorted by time step, so only this thread's range is visited.
+            const WorkloadEntry* end = this->problem->WorkloadEnd(i, start_times[i]);
+            const WorkloadEntry* entry = this->problem->WorkloadBegin(i, start_times[i]);
+            if (first > 1) {
+                entry = lower_bound(entry, end, first, [](const WorkloadEntry& entry, int t) { return entry.t < t; });
             }
-            else if (total_resource_usage > resource.max[t - 1] + eps) {
-                penalty += (total_resource_usage - resource.max[t - 1]);
+            for (; entry != end && entry->t <= last; ++entry) {
+                resource_usage[entry->resource * time_steps + entry->t - 1] += entry->amount;
             }
         }
+
+        for (int t = first; t <= last; t++) {
+            for (size_t r = 0; r < resources; r++) {
+                resource_penalty[(t - 1) * resources + r] = this->problem->ResourceViolation(r, t, resource_usage[r * time_steps + t - 1]);
+            }
+        }
+    }
+
+    for (float violation : resource_penalty) {
+        penalty += violation;
     }
     return make_tuple(penalty > 0, penalty);
 }
 
-tuple<bool, float> Optimization::ExclusionConstraint(vector<int> start_times) {
+tuple<bool, float> Optimization::ExclusionConstraint(span<const int> start_times) {
     float penalty = 0.0;
 
-    for (const auto& exclusion : this->problem->exclusions) {
-        auto [i1, i2, season] = make_tuple(exclusion.interventions[0], exclusion.interventions[1], exclusion.season);
-        auto it1 = find_if(this->problem->interventions.begin(), this->problem->interventions.end(), [i1](const Intervention& i) { return i.name == i1; });
-        auto it2 = find_if(this->problem->interventions.begin(), this->problem->interventions.end(), [i2](const Intervention& i) { return i.name == i2; });
-
-        int start_1 = start_times[distance(this->problem->interventions.begin(), it1)];
-        int end_1 = start_1 + it1->delta[start_1 - 1] - 1;
-
-        int start_2 = start_times[distance(this->problem->interventions.begin(), it2)];
-        int end_2 = start_2 + it2->delta[start_2 - 1] - 1;
-
-        int t_start = max(start_1, start_2);
-        int t_end = min(end_1, end_2);
-
-        if (t_start <= t_end) {
-            for (int t = t_start; t <= t_end; t++) {
-                if (find(season.duration.begin(), season.duration.end(), t) != season.duration.end()) {
-                    penalty += 1.0;
-                }
-            }
-        }
+    for (size_t e = 0; e < this->problem->exclusions.size(); e++) {
+        const Exclusion& exclusion = this->problem->exclusions[e];
+        penalty += this->problem->ExclusionOverlap(e, start_times[exclusion.first], start_times[exclusion.second]);
     }
 
     return make_tuple(penalty > 0, penalty);
 }
 
-tuple<bool, float> Optimization::ConstraintSatisfied(vector<int> start_times) {
-    float penalty = 0.0;
-
-    // cout << "Start times: ";
-    // for (const auto& i : start_times) {
-    //     cout << i << " ";
-    // }
-    // cout << endl;
+tuple<bool, float> Optimization::ConstraintSatisfied(span<const int> start_times) {
+    return Constraints(start_times, StepThreads(1));
+}
 
+tuple<bool, float> Optimization::Constraints(span<const int> start_times, int threads) {
     auto [violated, pen] = InterventionConstraint(start_times);
+    auto [violated2, pen2] = ResourceConstraint(start_times, threads);
+    auto [violated3, pen3] = ExclusionConstraint(start_times);
 
-    if (violated) {
-        //cout << "Intervention constraint violated." << endl;
-        penalty += pen * 1e6;
-    }
+    float penalty = Penalty(pen, pen2, pen3);
+    return make_tuple(penalty == 0.0, penalty);
+}
 
-    auto [violated2, pen2] = ResourceConstraint(start_times);
+float Optimization::Penalty(float intervention_violation, float resource_violation, float exclusion_violation) const {
+    float penalty = 0.0;
 
-    if (violated2) {
-        //cout << "Resource constraint violated." << endl;
-        penalty += pen2 * 1e6;
+    if (intervention_violation > 0) {
+        penalty += intervention_violation * 1e6;
     }
-
-    auto [violated3, pen3] = ExclusionConstraint(start_times);
-
-    if (violated3) {
-        //cout << "Exclusion constraint violated." << endl;
-        penalty += pen3 * 1e6;
+    if (resource_violation > 0) {
+        penalty += resource_violation * 1e6;
+    }
+    if (exclusion_violation > 0) {
+        penalty += exclusion_violation * 1e6;
     }
 
-    return make_tuple(penalty == 0.0, penalty);
-
-}
\ No newline at end of file
+    return penalty;
+}
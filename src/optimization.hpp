@@ -8,13 +8,41 @@
 #include <iostream>
 #include <iomanip>
 #include <chrono>
+#include <span>
+#include <limits>
+#include <omp.h>
 #include "problem.hpp"
+#include "kernels.hpp"
 #include "gurobi.hpp"
-#include "de.hpp"
 #include "../utils/log.hpp"
 
 const double TIME_LIMIT = 60.0 * 15.0;
 
+// Scenario racing samples one block of RACING_BLOCK consecutive scenarios out
+// of every few, about RACING_SAMPLES per time step. It is only used when time
+// steps carry RACING_MIN_SCENARIOS scenarios on average, and only when
+// MPP_RACING is set to 1. A trial is rejected when its estimate minus
+// RACING_Z standard errors still reaches its cutoff.
+const int RACING_BLOCK = 16;
+const int RACING_SAMPLES = 64;
+const int RACING_MIN_SCENARIOS = 128;
+const float RACING_Z = 3.0;
+
+// Fewest time steps a thread is given when one evaluation is split over
+// several threads.
+const int STEP_CHUNK_MIN = 8;
+
+// Working buffers of one thread. They are sized when the Optimization is
+// built, so evaluating a schedule does not touch the heap.
+struct EvaluationScratch {
+    vector<float> risk_by_scenario;
+    vector<float> risk_total;
+    vector<float> step_excess;
+    vector<float> resource_usage;
+    vector<float> resource_penalty;
+    vector<float> sample_risk;
+};
+
 class Optimization {
 public:
     Problem* problem;
@@ -22,14 +50,50 @@ public:
     Optimization(Problem* problem);
 
     vector<pair<string, int>> OptimizationStep(const chrono::time_point<chrono::high_resolution_clock> start_time);
-    tuple<bool, float> ConstraintSatisfied(vector<int> start_times);
-    tuple<float, float, float> ObjectiveFunction(vector<int> start_times, float penalty = 0.0);
+    tuple<bool, float> ConstraintSatisfied(span<const int> start_times);
+    tuple<float, float, float> ObjectiveFunction(span<const int> start_times, float penalty = 0.0);
+    // Writes (objective + penalty, mean risk, expected excess) of each
+    // schedule into results, which must hold one entry per schedule. With
+    // cutoffs, an individual stops being evaluated once its objective is
+    // known to reach its cutoff; its entry then holds a lower bound that is
+    // at least the cutoff instead of the exact objective. With penalties,
+    // as ScreenBatch writes them, the constraints are not computed again.
+    void EvaluateBatch(span<const span<const int>> schedules, span<tuple<float, float, float>> results,
+        span<const float> cutoffs = {}, span<const float> penalties = {});
+    // Writes a lower confidence bound on each objective, estimated from the
+    // sampled scenarios, and each exact penalty. Returns false, writing
+    // nothing, when the instance has too few scenarios to race.
+    bool ScreenBatch(span<const span<const int>> schedules, span<float> bounds, span<float> penalties);
     void PrintSolution(vector<pair<string, int>> solution);
+    // Threads each individual's time steps are split over when a batch of
+    // this many individuals is evaluated; 1 when they are not split.
+    int StepThreads(size_t individuals) const;
 
 private:
-    tuple<bool, float> InterventionConstraint(vector<int> start_times);
-    tuple<bool, float> ResourceConstraint(vector<int> start_times);
-    tuple<bool, float> ExclusionConstraint(vector<int> start_times);
+    vector<EvaluationScratch> scratch;
+    bool racing = false;
+    vector<int> sample_block;
+    vector<size_t> sample_block_offset;
+    vector<size_t> sample_offset;
+
+    EvaluationScratch& Scratch();
+    // Objective from the final mean risk and a running sum of the per-step
+    // excess; a lower bound on the objective while the sum is incomplete.
+    float PartialObjective(float mean_risk, float expected_excess, float penalty) const;
+    pair<int, int> StepRange(int thread, int threads) const;
+    tuple<float, float, float> Objective(span<const int> start_times, float penalty, int threads);
+    // Constraints and objective of one schedule in a single pass over each
+    // intervention's window; stops early, as EvaluateBatch, once the cutoff is
+    // reached. A nonnegative penalty is taken as already known.
+    tuple<float, float, float> Evaluate(span<const int> start_times, float cutoff, float penalty = -1.0);
+    tuple<bool, float> Constraints(span<const int> start_times, int threads);
+    // Violations weighted into a penalty, in the order ConstraintSatisfied adds them.
+    float Penalty(float intervention_violation, float resource_violation, float exclusion_violation) const;
+    void IndexSamples();
+    tuple<float, float> ScreenObjective(span<const int> start_times);
+    tuple<bool, float> InterventionConstraint(span<const int> start_times);
+    tuple<bool, float> ResourceConstraint(span<const int> start_times, int threads = 1);
+    tuple<bool, float> ExclusionConstraint(span<const int> start_times);
 };
 
 #endif
\ No newline at end of file
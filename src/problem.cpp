@@ -1,14 +1,27 @@
+#include <bit>
 #include "problem.hpp"
 
 using namespace std;
 
-Problem::Problem(rapidjson::Document* doc, string file_name) {
+Problem::Problem(string file_name, bool keep_maps) {
     this->file_name = file_name;
-    this->resources = GetResources(doc);
-    this->interventions = GetInterventions(doc);
-    this->exclusions = GetExclusions(doc);
+    this->keep_maps = keep_maps;
+    this->time_steps = -1;
+    this->quantile = -1;
+    this->alpha = -1;
+    this->computation_time = -1;
+}
+
+Problem::Problem(rapidjson::Document* doc, string file_name, bool keep_maps) {
+    this->file_name = file_name;
+    this->keep_maps = keep_maps;
     this->scenarios = GetScenarios(doc);
     this->time_steps = GetTimeSteps(doc);
+    this->resources = GetResources(doc);
+    this->seasons = GetSeasons(doc);
+    GetInterventions(doc);
+    this->exclusions = GetExclusions(doc);
+    IndexExclusions();
     this->quantile = GetQuantile(doc);
     this->alpha = GetAlpha(doc);
     this->computation_time = GetComputationTime(doc);
@@ -58,15 +71,14 @@ vector<Resource> Problem::GetResources(rapidjson::Document* doc) {
     return resources;
 }
 
-vector<Intervention> Problem::GetInterventions(rapidjson::Document* doc) {
-    vector<Intervention> interventions;
-
+void Problem::GetInterventions(rapidjson::Document* doc) {
     if (!doc->HasMember("Interventions") || !(*doc)["Interventions"].IsObject()) {
         cerr << "Invalid or missing 'Resources' key in JSON." << endl;
-        return interventions;
+        return;
     }
 
     const rapidjson::Value& interventions_data = (*doc)["Interventions"];
+    vector<rapidjson::Value::ConstMemberIterator> members;
     for (auto itr = interventions_data.MemberBegin(); itr != interventions_data.MemberEnd(); ++itr) {
         if (!itr->value.IsObject() ||
             !itr->value.HasMember("tmax") || !itr->value["tmax"].IsString() ||
@@ -77,86 +89,466 @@ vector<Intervention> Problem::GetInterventions(rapidjson::Document* doc) {
             continue;
         }
 
-        Intervention intervention;
-        intervention.name = itr->name.GetString();
-        intervention.tmax = stoi(itr->value["tmax"].GetString());
+        members.push_back(itr);
+    }
+
+    vector<InterventionRecord> records(members.size());
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t k = 0; k < members.size(); k++) {
+        auto itr = members[k];
+        InterventionRecord& record = records[k];
+        record.intervention.name = itr->name.GetString();
+        record.intervention.tmax = stoi(itr->value["tmax"].GetString());
 
         for (const auto& v : itr->value["Delta"].GetArray()) {
             if (v.IsNumber()) {
-                intervention.delta.push_back(v.GetFloat());
+                record.intervention.delta.push_back(v.GetFloat());
             }
             else {
                 cerr << "Invalid Delta value for: " << itr->name.GetString() << endl;
             }
         }
 
-        intervention.workload = Problem::GetWorkload(itr->value["workload"]);
-        intervention.risk = Problem::GetRisk(itr->value["risk"]);
-
-        interventions.push_back(intervention);
+        Problem::GetWorkload(itr->value["workload"], record);
+        Problem::GetRisk(itr->value["risk"], record);
     }
 
-    return interventions;
+    AddInterventions(records);
 }
 
-unordered_map<string, unordered_map<string, unordered_map<string, float>>> Problem::GetWorkload(const rapidjson::Value& workload) {
-
-    unordered_map<string,
-        unordered_map<string,
-        unordered_map<string, float>>> resource_workload;
-
+void Problem::GetWorkload(const rapidjson::Value& workload, InterventionRecord& record) const {
     for (auto itr = workload.MemberBegin(); itr != workload.MemberEnd(); ++itr) {
         if (!itr->value.IsObject()) {
             cerr << "Invalid workload format for: " << itr->name.GetString() << endl;
             continue;
         }
 
+        int resource = record.resources.size();
+        record.resources.push_back(itr->name.GetString());
+
         for (auto itr2 = itr->value.MemberBegin(); itr2 != itr->value.MemberEnd(); ++itr2) {
             if (!itr2->value.IsObject()) {
                 cerr << "Invalid workload format for: " << itr->name.GetString() << endl;
                 continue;
             }
 
+            int t = stoi(itr2->name.GetString());
             for (auto itr3 = itr2->value.MemberBegin(); itr3 != itr2->value.MemberEnd(); ++itr3) {
                 if (!itr3->value.IsNumber()) {
                     cerr << "Invalid workload format for: " << itr->name.GetString() << endl;
                     continue;
                 }
 
-                resource_workload[itr->name.GetString()][itr2->name.GetString()][itr3->name.GetString()] = itr3->value.GetFloat();
+                record.workload.push_back({ resource, t, stoi(itr3->name.GetString()), itr3->value.GetFloat() });
             }
         }
     }
-
-    return resource_workload;
 }
 
-unordered_map<string, unordered_map<string, vector<float>>> Problem::GetRisk(const rapidjson::Value& risk) {
-    unordered_map<string,
-        unordered_map<string,
-        vector<float>>> intervention_risk;
-
+void Problem::GetRisk(const rapidjson::Value& risk, InterventionRecord& record) const {
     for (auto itr = risk.MemberBegin(); itr != risk.MemberEnd(); ++itr) {
+        int t = stoi(itr->name.GetString());
+
         for (auto itr2 = itr->value.MemberBegin(); itr2 != itr->value.MemberEnd(); ++itr2) {
             if (!itr2->value.IsArray()) {
                 cerr << "Invalid risk format for: " << itr->name.GetString() << endl;
                 continue;
             }
 
+            RiskRecord row = { t, stoi(itr2->name.GetString()), record.risk_values.size(), 0 };
             for (const auto& v : itr2->value.GetArray()) {
                 if (v.IsNumber()) {
-                    intervention_risk[itr->name.GetString()][itr2->name.GetString()].push_back(v.GetFloat());
+                    record.risk_values.push_back(v.GetFloat());
+                    row.count++;
                 }
                 else {
                     cerr << "Invalid risk value for: " << itr->name.GetString() << endl;
                 }
             }
+            record.risk.push_back(row);
+        }
+    }
+}
+
+void Problem::AddInterventions(vector<InterventionRecord>& records) {
+    if (this->workload_offset.empty()) {
+        this->scenario_offset = GetScenarioOffset();
+        this->workload_offset.push_back(0);
+    }
+
+    IndexSymbols();
+
+    // Without a single start an intervention cannot be scheduled at all.
+    erase_if(records, [](const InterventionRecord& record) {
+        if (record.intervention.tmax < 1) {
+            cerr << "Invalid tmax for: " << record.intervention.name << endl;
+            return true;
+        }
+        return false;
+    });
+
+    // Interventions are indexed independently into their own pieces, then
+    // appended in record order so the layout does not depend on scheduling.
+    vector<IndexedIntervention> pieces(records.size());
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t k = 0; k < records.size(); k++) {
+        IndexWorkload(records[k], pieces[k]);
+        IndexRisk(records[k], pieces[k]);
+
+        if (this->keep_maps) {
+            InterventionRecord& record = records[k];
+            for (const auto& entry : record.workload) {
+                record.intervention.workload[record.resources[entry.resource]][to_string(entry.t)][to_string(entry.start_time)] = entry.amount;
+            }
+
+            for (const auto& row : record.risk) {
+                vector<float>& values = record.intervention.risk[to_string(row.t)][to_string(row.start_time)];
+                values.insert(values.end(), record.risk_values.begin() + row.begin, record.risk_values.begin() + row.begin + row.count);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < records.size(); k++) {
+        IndexedIntervention& piece = pieces[k];
+
+        this->schedule_offset.push_back(this->risk_offset.size());
+        for (size_t offset : piece.risk_offset) {
+            this->risk_offset.push_back(this->risk_values.size() + offset);
+        }
+        this->risk_values.insert(this->risk_values.end(), piece.risk_values.begin(), piece.risk_values.end());
+
+        for (size_t offset : piece.workload_offset) {
+            this->workload_offset.push_back(this->workload_entries.size() + offset);
+        }
+        this->workload_entries.insert(this->workload_entries.end(), piece.workload_entries.begin(), piece.workload_entries.end());
+
+        this->interventions.push_back(move(records[k].intervention));
+        records[k] = InterventionRecord();
+        piece = IndexedIntervention();
+    }
+
+    this->risk_data = this->risk_values;
+    this->workload_data = this->workload_entries;
+
+    IndexSchedules();
+    IndexMeanRisk();
+}
+
+void Problem::IndexSchedules() {
+    this->end_time.clear();
+    this->window_end.clear();
+    this->window_length.clear();
+
+    for (const auto& intervention : this->interventions) {
+        if (intervention.tmax > int(intervention.delta.size())) {
+            cerr << "Delta is shorter than tmax for: " << intervention.name << endl;
+        }
+
+        for (int st = 1; st <= intervention.tmax; st++) {
+            int end = GetEndTime(intervention, st);
+            int last = min(this->time_steps, end);
+
+            this->end_time.push_back(end);
+            this->window_end.push_back(last);
+            this->window_length.push_back(max(0, last - st + 1));
+        }
+    }
+}
+
+void Problem::IndexMeanRisk() {
+    this->mean_risk.assign(this->end_time.size(), 0.0);
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < this->interventions.size(); i++) {
+        for (int st = 1; st <= this->interventions[i].tmax; st++) {
+            double total = 0.0;
+            for (int t = st; t <= WindowEnd(i, st); t++) {
+                int scenarios_t = this->scenarios[t - 1];
+                const float* risk_row = RiskRow(i, st, t);
+                double risk_t = 0.0;
+                for (int s = 0; s < scenarios_t; s++) {
+                    risk_t += risk_row[s];
+                }
+                total += risk_t / max(1, scenarios_t);
+            }
+            this->mean_risk[ScheduleIndex(i, st)] = total;
+        }
+    }
+}
+
+int Problem::GetEndTime(const Intervention& intervention, int start_time) const {
+    if (start_time < 1 || start_time > int(intervention.delta.size())) {
+        return start_time - 1;
+    }
+
+    return start_time + intervention.delta[start_time - 1] - 1;
+}
+
+void Problem::IndexWorkload(const InterventionRecord& record, IndexedIntervention& piece) const {
+    const Intervention& intervention = record.intervention;
+    vector<int> resource_index;
+    vector<vector<WorkloadEntry>> entries_by_start(intervention.tmax + 1);
+
+    for (const auto& resource_name : record.resources) {
+        auto resource_it = this->resource_ids.find(resource_name);
+
+        if (resource_it == this->resource_ids.end()) {
+            cerr << "Invalid workload format for: " << resource_name << endl;
+            resource_index.push_back(-1);
+            continue;
+        }
+
+        resource_index.push_back(resource_it->second);
+    }
+
+    for (const auto& entry : record.workload) {
+        int t = entry.t;
+        int st = entry.start_time;
+
+        if (resource_index[entry.resource] < 0 || entry.amount == 0.0f ||
+            st < 1 || st > intervention.tmax || t < st || t > min(this->time_steps, GetEndTime(intervention, st))) {
+            continue;
+        }
+
+        entries_by_start[st].push_back({ resource_index[entry.resource], t, entry.amount });
+    }
+
+    for (int st = 1; st <= intervention.tmax; st++) {
+        stable_sort(entries_by_start[st].begin(), entries_by_start[st].end(), [](const WorkloadEntry& a, const WorkloadEntry& b) {
+            return a.t < b.t || (a.t == b.t && a.resource < b.resource);
+        });
+        piece.workload_entries.insert(piece.workload_entries.end(), entries_by_start[st].begin(), entries_by_start[st].end());
+        piece.workload_offset.push_back(piece.workload_entries.size());
+    }
+}
+
+void Problem::IndexRisk(const InterventionRecord& record, IndexedIntervention& piece) const {
+    const Intervention& intervention = record.intervention;
+
+    // Reserve a zeroed row for every time step of every active window, so
+    // missing or short entries read as zero risk.
+    vector<int> window_end(intervention.tmax + 1, 0);
+    for (int st = 1; st <= intervention.tmax; st++) {
+        piece.risk_offset.push_back(piece.risk_values.size());
+
+        window_end[st] = min(this->time_steps, GetEndTime(intervention, st));
+        if (window_end[st] >= st) {
+            piece.risk_values.resize(piece.risk_values.size() + this->scenario_offset[window_end[st]] - this->scenario_offset[st - 1], 0.0f);
+        }
+    }
+
+    for (const auto& row : record.risk) {
+        int t = row.t;
+        int st = row.start_time;
+
+        if (st < 1 || st > intervention.tmax || t < st || t > window_end[st]) {
+            continue;
+        }
+
+        size_t count = min(row.count, size_t(this->scenarios[t - 1]));
+        float* risk_row = &piece.risk_values[piece.risk_offset[st - 1] + this->scenario_offset[t - 1] - this->scenario_offset[st - 1]];
+        copy(record.risk_values.begin() + row.begin, record.risk_values.begin() + row.begin + count, risk_row);
+    }
+}
+
+void Problem::IndexSymbols() {
+    this->resource_ids.clear();
+    for (size_t r = 0; r < this->resources.size(); r++) {
+        this->resource_ids[this->resources[r].name] = r;
+    }
+
+    this->intervention_ids.clear();
+    for (size_t i = 0; i < this->interventions.size(); i++) {
+        this->intervention_ids[this->interventions[i].name] = i;
+    }
+
+    this->season_ids.clear();
+    for (size_t s = 0; s < this->seasons.size(); s++) {
+        this->season_ids[this->seasons[s].name] = s;
+    }
+}
+
+void Problem::IndexExclusions() {
+    IndexSymbols();
+
+    vector<Exclusion> exclusions;
+    for (auto& exclusion : this->exclusions) {
+        auto first_it = this->intervention_ids.find(exclusion.interventions[0]);
+        auto second_it = this->intervention_ids.find(exclusion.interventions[1]);
+        auto season_it = this->season_ids.find(exclusion.season_name);
+
+        if (first_it == this->intervention_ids.end() || second_it == this->intervention_ids.end() ||
+            season_it == this->season_ids.end()) {
+            cerr << "Invalid exclusion format for: " << exclusion.name << endl;
+            continue;
+        }
+
+        exclusion.first = first_it->second;
+        exclusion.second = second_it->second;
+        exclusion.season = season_it->second;
+        exclusions.push_back(exclusion);
+    }
+
+    this->exclusions = exclusions;
+    IndexSeasons();
+    IndexDomains();
+}
+
+void Problem::IndexSeasons() {
+    // Cover every listed season step, even past T, since windows may run past T.
+    int horizon = max(this->time_steps, 1);
+    for (const auto& season : this->seasons) {
+        for (int t : season.duration) {
+            horizon = max(horizon, t);
+        }
+    }
+
+    this->season_words = (horizon + 63) / 64;
+    this->season_mask.assign(this->seasons.size() * this->season_words, 0);
+    for (size_t s = 0; s < this->seasons.size(); s++) {
+        for (int t : this->seasons[s].duration) {
+            if (t >= 1) {
+                this->season_mask[s * this->season_words + (t - 1) / 64] |= uint64_t(1) << ((t - 1) % 64);
+            }
+        }
+    }
+
+    size_t n = this->interventions.size();
+    this->exclusion_offset.assign(n + 1, 0);
+    for (const auto& exclusion : this->exclusions) {
+        this->exclusion_offset[exclusion.first + 1]++;
+        if (exclusion.second != exclusion.first) {
+            this->exclusion_offset[exclusion.second + 1]++;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        this->exclusion_offset[i + 1] += this->exclusion_offset[i];
+    }
+
+    this->intervention_exclusions.resize(this->exclusion_offset[n]);
+    vector<int> cursor(this->exclusion_offset.begin(), this->exclusion_offset.end() - 1);
+    for (size_t e = 0; e < this->exclusions.size(); e++) {
+        this->intervention_exclusions[cursor[this->exclusions[e].first]++] = e;
+        if (this->exclusions[e].second != this->exclusions[e].first) {
+            this->intervention_exclusions[cursor[this->exclusions[e].second]++] = e;
+        }
+    }
+}
+
+void Problem::IndexDomains() {
+    float eps = 1e-6;
+    size_t n = this->interventions.size();
+
+    // A single workload entry above the resource maximum can only be offset
+    // by negative workloads elsewhere.
+    bool nonnegative = all_of(this->workload_data.begin(), this->workload_data.end(),
+        [](const WorkloadEntry& entry) { return entry.amount >= 0; });
+
+    // Drop starts whose window runs past T or whose own workload exceeds a
+    // resource maximum; such starts are penalized whatever the others do.
+    vector<vector<int>> domains(n);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < n; i++) {
+        for (int st = 1; st <= this->interventions[i].tmax; st++) {
+            bool feasible = EndTime(i, st) <= this->time_steps;
+            const WorkloadEntry* end = WorkloadEnd(i, st);
+            for (const WorkloadEntry* entry = WorkloadBegin(i, st); feasible && nonnegative && entry != end; ++entry) {
+                feasible = entry->amount <= this->resources[entry->resource].max[entry->t - 1] + eps;
+            }
+            if (feasible) {
+                domains[i].push_back(st);
+            }
+        }
+    }
+
+    // Left with no start, keep them all and let the search weigh the penalties.
+    for (size_t i = 0; i < n; i++) {
+        if (domains[i].empty()) {
+            for (int st = 1; st <= this->interventions[i].tmax; st++) {
+                domains[i].push_back(st);
+            }
+        }
+    }
+
+    // An intervention with a single start fixes its window, so its exclusion
+    // partners lose the starts that overlap it in the season. Partners that
+    // become fixed in turn are propagated until nothing changes.
+    vector<int> fixed;
+    for (size_t i = 0; i < n; i++) {
+        if (domains[i].size() == 1) {
+            fixed.push_back(i);
+        }
+    }
+
+    vector<int> kept;
+    while (!fixed.empty()) {
+        int i = fixed.back();
+        fixed.pop_back();
+
+        for (int e : ExclusionsOf(i)) {
+            const Exclusion& exclusion = this->exclusions[e];
+            if (exclusion.first == exclusion.second) {
+                continue;
+            }
+            int partner = exclusion.first == i ? exclusion.second : exclusion.first;
+            if (domains[partner].size() == 1) {
+                continue;
+            }
+
+            kept.clear();
+            for (int st : domains[partner]) {
+                int overlap = exclusion.first == i ?
+                    ExclusionOverlap(e, domains[i][0], st) : ExclusionOverlap(e, st, domains[i][0]);
+                if (overlap == 0) {
+                    kept.push_back(st);
+                }
+            }
+
+            if (!kept.empty() && kept.size() < domains[partner].size()) {
+                domains[partner] = kept;
+                if (kept.size() == 1) {
+                    fixed.push_back(partner);
+                }
+            }
         }
     }
 
-    return intervention_risk;
+    this->domain_offset.assign(n + 1, 0);
+    this->domain_values.clear();
+    for (size_t i = 0; i < n; i++) {
+        this->domain_values.insert(this->domain_values.end(), domains[i].begin(), domains[i].end());
+        this->domain_offset[i + 1] = this->domain_values.size();
+    }
 }
 
+int Problem::ExclusionOverlap(int exclusion, int start_1, int start_2) const {
+    const Exclusion& e = this->exclusions[exclusion];
+    if (!ValidStart(e.first, start_1) || !ValidStart(e.second, start_2)) {
+        return 0;
+    }
+
+    int t_start = max(start_1, start_2);
+    int t_end = min({ EndTime(e.first, start_1), EndTime(e.second, start_2), this->season_words * 64 });
+    if (t_start > t_end) {
+        return 0;
+    }
+
+    // AND the season with a mask of [t_start, t_end], one word at a time.
+    const uint64_t* mask = &this->season_mask[e.season * this->season_words];
+    int first = (t_start - 1) / 64;
+    int last = (t_end - 1) / 64;
+    int overlap = 0;
+    for (int w = first; w <= last; w++) {
+        uint64_t range = ~uint64_t(0);
+        if (w == first) range &= ~uint64_t(0) << ((t_start - 1) % 64);
+        if (w == last) range &= ~uint64_t(0) >> (63 - (t_end - 1) % 64);
+        overlap += popcount(mask[w] & range);
+    }
+
+    return overlap;
+}
 
 vector<Exclusion> Problem::GetExclusions(rapidjson::Document* doc) {
     vector<Exclusion> exclusions;
@@ -166,15 +558,10 @@ vector<Exclusion> Problem::GetExclusions(rapidjson::Document* doc) {
         return exclusions;
     }
 
-    if (!doc->HasMember("Seasons") || !(*doc)["Seasons"].IsObject()) {
-        cerr << "Invalid or missing 'Seasons' key in JSON." << endl;
-        return exclusions;
-    }
-
     const rapidjson::Value& exclusions_data = (*doc)["Exclusions"];
 
     for (auto itr = exclusions_data.MemberBegin(); itr != exclusions_data.MemberEnd(); ++itr) {
-        if (!itr->value.IsArray()) {
+        if (!itr->value.IsArray() || itr->value.Size() < 3) {
             cerr << "Invalid exclusion format for: " << itr->name.GetString() << endl;
             continue;
         }
@@ -183,7 +570,7 @@ vector<Exclusion> Problem::GetExclusions(rapidjson::Document* doc) {
         exclusion.name = itr->name.GetString();
         exclusion.interventions.push_back(itr->value.GetArray()[0].GetString());
         exclusion.interventions.push_back(itr->value.GetArray()[1].GetString());
-        exclusion.season = Problem::GetSeason((*doc)["Seasons"], itr->value.GetArray()[2].GetString());
+        exclusion.season_name = itr->value.GetArray()[2].GetString();
 
         exclusions.push_back(exclusion);
     }
@@ -191,14 +578,27 @@ vector<Exclusion> Problem::GetExclusions(rapidjson::Document* doc) {
     return exclusions;
 }
 
+vector<Season> Problem::GetSeasons(rapidjson::Document* doc) {
+    vector<Season> seasons;
+
+    if (!doc->HasMember("Seasons") || !(*doc)["Seasons"].IsObject()) {
+        cerr << "Invalid or missing 'Seasons' key in JSON." << endl;
+        return seasons;
+    }
+
+    const rapidjson::Value& seasons_data = (*doc)["Seasons"];
+
+    for (auto itr = seasons_data.MemberBegin(); itr != seasons_data.MemberEnd(); ++itr) {
+        seasons.push_back(Problem::GetSeason(seasons_data, itr->name.GetString()));
+    }
+
+    return seasons;
+}
+
 Season Problem::GetSeason(const rapidjson::Value& season, string season_name) {
     Season s;
     s.name = season_name;
 
-    // cout << "Getting season: " << season_name << endl;
-    // cout << season.HasMember(season_name.c_str()) << endl;
-    // cout << season[season_name.c_str()].IsArray() << endl;
-
     if (!season.HasMember(season_name.c_str()) || !season[season_name.c_str()].IsArray()) {
         cerr << "Invalid season format for: " << season_name << endl;
         return s;
@@ -271,4 +671,14 @@ float Problem::GetComputationTime(rapidjson::Document* doc) {
     }
 
     return (*doc)["ComputationTime"].GetFloat();
+}
+
+vector<size_t> Problem::GetScenarioOffset() {
+    vector<size_t> scenario_offset(this->scenarios.size() + 1, 0);
+
+    for (size_t t = 0; t < this->scenarios.size(); t++) {
+        scenario_offset[t + 1] = scenario_offset[t] + this->scenarios[t];
+    }
+
+    return scenario_offset;
 }
\ No newline at end of file
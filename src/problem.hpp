@@ -3,7 +3,11 @@
 
 #include <iostream>
 #include <string>
+#include <algorithm>
 #include <vector>
+#include <span>
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include "../rapidjson/document.h"
 
@@ -27,6 +31,44 @@ struct Intervention {
     int tmax;
 };
 
+struct WorkloadEntry {
+    int resource;
+    int t;
+    float amount;
+};
+
+struct WorkloadRecord {
+    int resource;
+    int t;
+    int start_time;
+    float amount;
+};
+
+struct RiskRecord {
+    int t;
+    int start_time;
+    size_t begin;
+    size_t count;
+};
+
+// An intervention as read from the instance file, before it is indexed.
+struct InterventionRecord {
+    Intervention intervention;
+    vector<string> resources;
+    vector<WorkloadRecord> workload;
+    vector<RiskRecord> risk;
+    vector<float> risk_values;
+};
+
+// Dense and compressed tables of one intervention, with offsets relative
+// to its own arrays, before they are appended to the Problem.
+struct IndexedIntervention {
+    vector<float> risk_values;
+    vector<size_t> risk_offset;
+    vector<WorkloadEntry> workload_entries;
+    vector<size_t> workload_offset;
+};
+
 struct Season {
     string name;
     vector<int> duration;
@@ -35,7 +77,10 @@ struct Season {
 struct Exclusion {
     string name;
     vector<string> interventions;
-    Season season;
+    string season_name;
+    int first;
+    int second;
+    int season;
 };
 
 
@@ -45,26 +90,184 @@ public:
     vector<Resource> resources;
     vector<Intervention> interventions;
     vector<Exclusion> exclusions;
+    vector<Season> seasons;
     vector<int> scenarios;
     int time_steps;
     float quantile;
     float alpha;
     float computation_time;
 
-    Problem(rapidjson::Document* doc, string file_name);
+    // Symbol tables from names to dense ids, used while loading; the
+    // evaluators only see the ids.
+    unordered_map<string, int> resource_ids;
+    unordered_map<string, int> intervention_ids;
+    unordered_map<string, int> season_ids;
+
+    // Dense risk tensor: one row of scenarios[t - 1] values for every
+    // (intervention, start time, t) with t inside the active window.
+    span<const float> risk_data;
+    vector<size_t> risk_offset;
+    vector<int> schedule_offset;
+    vector<size_t> scenario_offset;
+
+    // Compressed workload: the nonzero (resource, t, amount) entries of every
+    // (intervention, start time) lie in [workload_offset[k], workload_offset[k + 1]),
+    // ordered by t and then by resource.
+    span<const WorkloadEntry> workload_data;
+    vector<size_t> workload_offset;
+
+    // Per (intervention, start time): last active time step, the same
+    // clamped to T, and the number of active time steps within the horizon.
+    vector<int> end_time;
+    vector<int> window_end;
+    vector<int> window_length;
+
+    // Per (intervention, start time): the sum over the active window of the
+    // scenario mean of the intervention's risk. Mean risk is linear in the
+    // schedule, so it is the sum of these over the interventions, over T.
+    vector<double> mean_risk;
+
+    // Each season as a bitmap over time steps, bit t - 1 of word (t - 1) / 64
+    // in the season's season_words words, and per intervention the
+    // exclusions it takes part in, in [exclusion_offset[i], exclusion_offset[i + 1]).
+    vector<uint64_t> season_mask;
+    int season_words = 0;
+    vector<int> intervention_exclusions;
+    vector<int> exclusion_offset;
+
+    // Per intervention, the sorted start times that presolve could not rule
+    // out, in [domain_offset[i], domain_offset[i + 1]).
+    vector<int> domain_values;
+    vector<int> domain_offset;
+
+    // Owns risk_data and workload_data when they come from a mapped cache
+    // file instead of risk_values and workload_entries.
+    shared_ptr<const void> storage;
+
+    Problem(string file_name, bool keep_maps = false);
+    Problem(rapidjson::Document* doc, string file_name, bool keep_maps = false);
+    Problem(const Problem&) = delete;
+    Problem(Problem&&) = default;
+    Problem& operator=(const Problem&) = delete;
+    Problem& operator=(Problem&&) = default;
+
+    void AddInterventions(vector<InterventionRecord>& records);
+    void IndexSymbols();
+    void IndexSchedules();
+    void IndexMeanRisk();
+    void IndexExclusions();
+    void IndexSeasons();
+    void IndexDomains();
+
+    int ScheduleIndex(int intervention, int start_time) const {
+        return this->schedule_offset[intervention] + start_time - 1;
+    }
+
+    bool ValidStart(int intervention, int start_time) const {
+        return 1 <= start_time && start_time <= this->interventions[intervention].tmax;
+    }
+
+    int EndTime(int intervention, int start_time) const {
+        return this->end_time[ScheduleIndex(intervention, start_time)];
+    }
+
+    int WindowEnd(int intervention, int start_time) const {
+        return this->window_end[ScheduleIndex(intervention, start_time)];
+    }
+
+    bool InSeason(int season, int t) const {
+        return 1 <= t && t <= this->season_words * 64 &&
+            (this->season_mask[season * this->season_words + (t - 1) / 64] >> ((t - 1) % 64) & 1);
+    }
+
+    span<const int> ExclusionsOf(int intervention) const {
+        return span<const int>(this->intervention_exclusions).subspan(this->exclusion_offset[intervention],
+            this->exclusion_offset[intervention + 1] - this->exclusion_offset[intervention]);
+    }
+
+    // Never empty, as interventions with tmax < 1 are dropped at load.
+    span<const int> Domain(int intervention) const {
+        return span<const int>(this->domain_values).subspan(this->domain_offset[intervention],
+            this->domain_offset[intervention + 1] - this->domain_offset[intervention]);
+    }
+
+    // The start time in the intervention's domain closest to start_time,
+    // the earlier one on ties.
+    int NearestStart(int intervention, int start_time) const {
+        span<const int> domain = Domain(intervention);
+        auto it = lower_bound(domain.begin(), domain.end(), start_time);
+        if (it == domain.end()) return domain.back();
+        if (it == domain.begin() || *it == start_time) return *it;
+        return start_time - *(it - 1) <= *it - start_time ? *(it - 1) : *it;
+    }
+
+    // Number of time steps of the exclusion's season covered by both
+    // windows; 0 when either start is invalid.
+    int ExclusionOverlap(int exclusion, int start_1, int start_2) const;
+
+    double MeanRisk(int intervention, int start_time) const {
+        return this->mean_risk[ScheduleIndex(intervention, start_time)];
+    }
+
+    // Mean risk of a schedule; interventions with an invalid start add nothing.
+    float MeanRisk(span<const int> start_times) const {
+        double total = 0.0;
+        for (size_t i = 0; i < start_times.size(); i++) {
+            if (ValidStart(i, start_times[i])) {
+                total += MeanRisk(i, start_times[i]);
+            }
+        }
+        return float(total / this->time_steps);
+    }
+
+    const float* RiskRow(int intervention, int start_time, int t) const {
+        return &this->risk_data[this->risk_offset[ScheduleIndex(intervention, start_time)] +
+            this->scenario_offset[t - 1] - this->scenario_offset[start_time - 1]];
+    }
+
+    const WorkloadEntry* WorkloadBegin(int intervention, int start_time) const {
+        return this->workload_data.data() + this->workload_offset[ScheduleIndex(intervention, start_time)];
+    }
+
+    const WorkloadEntry* WorkloadEnd(int intervention, int start_time) const {
+        return this->workload_data.data() + this->workload_offset[ScheduleIndex(intervention, start_time) + 1];
+    }
+
+    // Amount by which a usage of the resource at t falls outside its bounds,
+    // within a tolerance of 1e-6.
+    float ResourceViolation(int resource, int t, float usage) const {
+        float eps = 1e-6;
+        const Resource& bounds = this->resources[resource];
+        if (usage < bounds.min[t - 1] - eps) {
+            return bounds.min[t - 1] - usage;
+        }
+        if (usage > bounds.max[t - 1] + eps) {
+            return usage - bounds.max[t - 1];
+        }
+        return 0.0;
+    }
 
 private:
+    bool keep_maps;
+    vector<float> risk_values;
+    vector<WorkloadEntry> workload_entries;
+
     vector<Resource> GetResources(rapidjson::Document* doc);
-    vector<Intervention> GetInterventions(rapidjson::Document* doc);
-    unordered_map<string, unordered_map<string, unordered_map<string, float>>> GetWorkload(const rapidjson::Value& workload);
-    unordered_map<string, unordered_map<string, vector<float>>>  GetRisk(const rapidjson::Value& risk);
+    void GetInterventions(rapidjson::Document* doc);
+    void GetWorkload(const rapidjson::Value& workload, InterventionRecord& record) const;
+    void GetRisk(const rapidjson::Value& risk, InterventionRecord& record) const;
+    void IndexWorkload(const InterventionRecord& record, IndexedIntervention& piece) const;
+    void IndexRisk(const InterventionRecord& record, IndexedIntervention& piece) const;
     vector<Exclusion> GetExclusions(rapidjson::Document* doc);
+    vector<Season> GetSeasons(rapidjson::Document* doc);
     Season GetSeason(const rapidjson::Value& season, string season_name);
     vector<int> GetScenarios(rapidjson::Document* doc);
     int GetTimeSteps(rapidjson::Document* doc);
     float GetQuantile(rapidjson::Document* doc);
     float GetAlpha(rapidjson::Document* doc);
     float GetComputationTime(rapidjson::Document* doc);
+    vector<size_t> GetScenarioOffset();
+    int GetEndTime(const Intervention& intervention, int start_time) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "reader.hpp"
+
+InstanceReader::InstanceReader(Problem* problem) {
+    this->problem = problem;
+}
+
+rapidjson::ParseResult InstanceReader::Read(FILE* fp) {
+    char readBuffer[65536];
+    rapidjson::FileReadStream is(fp, readBuffer, sizeof(readBuffer));
+
+    rapidjson::Reader reader;
+    rapidjson::ParseResult result = reader.Parse(is, *this);
+
+    if (result) {
+        Finish();
+    }
+
+    return result;
+}
+
+void InstanceReader::Finish() {
+    // T and the scenario counts usually follow the interventions in the file,
+    // so the records can only be indexed once the whole document is read.
+    this->problem->AddInterventions(this->records);
+    this->records.clear();
+    this->problem->IndexExclusions();
+}
+
+rapidjson::ParseResult InstanceReader::ReadInsitu(char* buffer) {
+    rapidjson::InsituStringStream is(buffer);
+
+    rapidjson::Reader reader;
+    rapidjson::ParseResult result = reader.Parse<rapidjson::kParseInsituFlag>(is, *this);
+
+    if (result) {
+        Finish();
+    }
+
+    return result;
+}
+
+bool InstanceReader::StartObject() {
+    this->depth++;
+    return true;
+}
+
+bool InstanceReader::EndObject(rapidjson::SizeType) {
+    this->depth--;
+    return true;
+}
+
+bool InstanceReader::StartArray() {
+    this->depth++;
+
+    if (this->section == Section::Interventions && this->depth == 6 && this->field == "risk") {
+        InterventionRecord& record = this->records.back();
+        record.risk.push_back({ this->t, this->start_time, record.risk_values.size(), 0 });
+    }
+
+    return true;
+}
+
+bool InstanceReader::EndArray(rapidjson::SizeType) {
+    this->depth--;
+    return true;
+}
+
+bool InstanceReader::Key(const char* str, rapidjson::SizeType, bool) {
+    if (this->depth == 1) {
+        string key = str;
+        if (key == "Resources") this->section = Section::Resources;
+        else if (key == "Seasons") this->section = Section::Seasons;
+        else if (key == "Interventions") this->section = Section::Interventions;
+        else if (key == "Exclusions") this->section = Section::Exclusions;
+        else if (key == "T") this->section = Section::TimeSteps;
+        else if (key == "Scenarios_number") this->section = Section::Scenarios;
+        else if (key == "Quantile") this->section = Section::Quantile;
+        else if (key == "Alpha") this->section = Section::Alpha;
+        else if (key == "ComputationTime") this->section = Section::ComputationTime;
+        else this->section = Section::None;
+        return true;
+    }
+
+    switch (this->section) {
+    case Section::Resources:
+        if (this->depth == 2) {
+            Resource resource;
+            resource.name = str;
+            this->problem->resources.push_back(resource);
+        }
+        else if (this->depth == 3) {
+            this->field = str;
+        }
+        break;
+
+    case Section::Seasons:
+        if (this->depth == 2) {
+            Season season;
+            season.name = str;
+            this->problem->seasons.push_back(season);
+        }
+        break;
+
+    case Section::Exclusions:
+        if (this->depth == 2) {
+            Exclusion exclusion;
+            exclusion.name = str;
+            this->problem->exclusions.push_back(exclusion);
+        }
+        break;
+
+    case Section::Interventions:
+        if (this->depth == 2) {
+            this->records.emplace_back();
+            this->records.back().intervention.name = str;
+            this->records.back().intervention.tmax = 0;
+        }
+        else if (this->depth == 3) {
+            this->field = str;
+        }
+        else if (this->field == "workload") {
+            if (this->depth == 4) this->records.back().resources.push_back(str);
+            else if (this->depth == 5) this->t = atoi(str);
+            else if (this->depth == 6) this->start_time = atoi(str);
+        }
+        else if (this->field == "risk") {
+            if (this->depth == 4) this->t = atoi(str);
+            else if (this->depth == 5) this->start_time = atoi(str);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+bool InstanceReader::String(const char* str, rapidjson::SizeType, bool) {
+    if (this->section == Section::Seasons && this->depth == 3) {
+        this->problem->seasons.back().duration.push_back(atoi(str));
+    }
+    else if (this->section == Section::Exclusions && this->depth == 3) {
+        Exclusion& exclusion = this->problem->exclusions.back();
+        if (exclusion.interventions.size() < 2) {
+            exclusion.interventions.push_back(str);
+        }
+        else {
+            exclusion.season_name = str;
+        }
+    }
+    else if (this->section == Section::Interventions && this->depth == 3 && this->field == "tmax") {
+        // Rejected like the DOM loader, where stoi throws on a non-integer.
+        char* end;
+        long tmax = strtol(str, &end, 10);
+        if (end == str || *end != '\0') {
+            return Invalid();
+        }
+        this->records.back().intervention.tmax = int(tmax);
+    }
+    else if (this->section != Section::None) {
+        return Invalid();
+    }
+
+    return true;
+}
+
+bool InstanceReader::Number(double value) {
+    switch (this->section) {
+    case Section::Resources:
+        if (this->depth == 4 && this->field == "max") {
+            this->problem->resources.back().max.push_back(value);
+        }
+        else if (this->depth == 4 && this->field == "min") {
+            this->problem->resources.back().min.push_back(value);
+        }
+        break;
+
+    case Section::Interventions:
+        if (this->depth == 4 && this->field == "Delta") {
+            this->records.back().intervention.delta.push_back(value);
+        }
+        else if (this->depth == 6 && this->field == "workload") {
+            InterventionRecord& record = this->records.back();
+            record.workload.push_back({ int(record.resources.size()) - 1, this->t, this->start_time, float(value) });
+        }
+        else if (this->depth == 6 && this->field == "risk") {
+            InterventionRecord& record = this->records.back();
+            record.risk_values.push_back(value);
+            record.risk.back().count++;
+        }
+        else {
+            return Invalid();
+        }
+        break;
+
+    case Section::TimeSteps:
+        this->problem->time_steps = value;
+        break;
+
+    case Section::Scenarios:
+        this->problem->scenarios.push_back(value);
+        break;
+
+    case Section::Quantile:
+        this->problem->quantile = value;
+        break;
+
+    case Section::Alpha:
+        this->problem->alpha = value;
+        break;
+
+    case Section::ComputationTime:
+        this->problem->computation_time = value;
+        break;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+bool InstanceReader::Invalid() {
+    cerr << "Unexpected value in JSON at depth " << this->depth << "." << endl;
+    return false;
+}
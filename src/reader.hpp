@@ -0,0 +1,54 @@
+#ifndef READER_HPP
+#define READER_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../rapidjson/reader.h"
+#include "../rapidjson/filereadstream.h"
+#include "problem.hpp"
+
+using namespace std;
+
+// Streams an instance file into a Problem with rapidjson's SAX reader,
+// without building the intermediate Document.
+class InstanceReader : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, InstanceReader> {
+public:
+    Problem* problem;
+
+    InstanceReader(Problem* problem);
+
+    rapidjson::ParseResult Read(FILE* fp);
+    rapidjson::ParseResult ReadInsitu(char* buffer);
+
+    bool Null() { return this->section == Section::None || Invalid(); }
+    bool Bool(bool) { return this->section == Section::None || Invalid(); }
+    bool Int(int value) { return Number(value); }
+    bool Uint(unsigned value) { return Number(value); }
+    bool Int64(int64_t value) { return Number(value); }
+    bool Uint64(uint64_t value) { return Number(value); }
+    bool Double(double value) { return Number(value); }
+    bool String(const char* str, rapidjson::SizeType length, bool copy);
+    bool Key(const char* str, rapidjson::SizeType length, bool copy);
+    bool StartObject();
+    bool EndObject(rapidjson::SizeType member_count);
+    bool StartArray();
+    bool EndArray(rapidjson::SizeType element_count);
+
+private:
+    enum class Section { None, Resources, Seasons, Interventions, Exclusions, TimeSteps, Scenarios, Quantile, Alpha, ComputationTime };
+
+    Section section = Section::None;
+    int depth = 0;
+    string field;
+    int t = 0;
+    int start_time = 0;
+    vector<InterventionRecord> records;
+
+    bool Number(double value);
+    bool Invalid();
+    void Finish();
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "repair.hpp"
+
+Repair::Repair(Problem* problem) {
+    this->problem = problem;
+
+    int threads = omp_get_max_threads();
+    this->states.reserve(threads);
+    for (int k = 0; k < threads; k++) {
+        this->states.emplace_back(problem);
+        this->states.back().overlap.resize(problem->exclusions.size());
+        this->states.back().overflow.resize(problem->interventions.size());
+        this->states.back().marked.resize(problem->interventions.size());
+    }
+}
+
+Repair::State& Repair::Local() {
+    return this->states[omp_get_thread_num() % this->states.size()];
+}
+
+bool Repair::Apply(span<int> start_times, double time_limit) {
+    auto deadline = chrono::high_resolution_clock::now() + chrono::duration<double>(time_limit);
+    State& state = Local();
+    this->calls++;
+
+    // Unscheduled or out-of-range starts are replaced by the nearest allowed one.
+    for (size_t i = 0; i < start_times.size(); i++) {
+        if (!this->problem->ValidStart(i, start_times[i])) {
+            start_times[i] = this->problem->NearestStart(i, start_times[i]);
+        }
+    }
+
+    state.profile.Reset(start_times);
+
+    int exclusion_violation = 0;
+    for (size_t e = 0; e < this->problem->exclusions.size(); e++) {
+        const Exclusion& exclusion = this->problem->exclusions[e];
+        state.overlap[e] = this->problem->ExclusionOverlap(e, start_times[exclusion.first], start_times[exclusion.second]);
+        exclusion_violation += state.overlap[e];
+    }
+
+    int overflow_violation = 0;
+    for (size_t i = 0; i < start_times.size(); i++) {
+        state.overflow[i] = Overflow(i, start_times[i]);
+        overflow_violation += state.overflow[i];
+    }
+
+    double violation = state.profile.Violation() + exclusion_violation + overflow_violation;
+    if (violation <= 0) {
+        return true;
+    }
+    this->infeasible++;
+
+    // A pass only over the interventions that take part in a violation can
+    // miss cells below their minimum, so a pass that finds no move is retried
+    // once with every intervention.
+    bool all = false;
+    while (violation > 0 && chrono::high_resolution_clock::now() < deadline) {
+        Candidates(state, start_times, all);
+        bool moved = false;
+
+        for (int i : state.candidates) {
+            if (violation <= 0 || chrono::high_resolution_clock::now() >= deadline) {
+                break;
+            }
+
+            int current = start_times[i];
+            int best_start = current;
+            double best_delta = 0.0;
+            double best_risk = 0.0;
+            for (int st : this->problem->Domain(i)) {
+                if (st == current) {
+                    continue;
+                }
+                double delta = state.profile.MoveDelta(i, current, st) +
+                    ExclusionDelta(state, start_times, i, st) + Overflow(i, st) - state.overflow[i];
+                if (delta >= -1e-6) {
+                    continue;
+                }
+                double risk = this->problem->MeanRisk(i, st);
+                if (best_start == current || delta < best_delta - 1e-6 || (delta <= best_delta + 1e-6 && risk < best_risk)) {
+                    best_start = st;
+                    best_delta = delta;
+                    best_risk = risk;
+                }
+            }
+
+            if (best_start == current) {
+                continue;
+            }
+
+            state.profile.Move(i, current, best_start);
+            start_times[i] = best_start;
+            for (int e : this->problem->ExclusionsOf(i)) {
+                const Exclusion& exclusion = this->problem->exclusions[e];
+                int overlap = this->problem->ExclusionOverlap(e, start_times[exclusion.first], start_times[exclusion.second]);
+                exclusion_violation += overlap - state.overlap[e];
+                state.overlap[e] = overlap;
+            }
+            overflow_violation -= state.overflow[i];
+            state.overflow[i] = Overflow(i, best_start);
+            overflow_violation += state.overflow[i];
+
+            violation = state.profile.Violation() + exclusion_violation + overflow_violation;
+            moved = true;
+            this->moves++;
+        }
+
+        if (!moved) {
+            if (all) {
+                break;
+            }
+            all = true;
+        }
+        else {
+            all = false;
+        }
+    }
+
+    if (violation <= 0) {
+        this->repaired++;
+    }
+    return violation <= 0;
+}
+
+int Repair::Overflow(int intervention, int start_time) const {
+    return max(0, this->problem->EndTime(intervention, start_time) - this->problem->time_steps);
+}
+
+int Repair::ExclusionDelta(const State& state, span<const int> start_times, int intervention, int new_start) const {
+    int delta = 0;
+    for (int e : this->problem->ExclusionsOf(intervention)) {
+        const Exclusion& exclusion = this->problem->exclusions[e];
+        int start_1 = exclusion.first == intervention ? new_start : start_times[exclusion.first];
+        int start_2 = exclusion.second == intervention ? new_start : start_times[exclusion.second];
+        delta += this->problem->ExclusionOverlap(e, start_1, start_2) - state.overlap[e];
+    }
+    return delta;
+}
+
+void Repair::Candidates(State& state, span<const int> start_times, bool all) {
+    state.candidates.clear();
+
+    if (all) {
+        for (size_t i = 0; i < start_times.size(); i++) {
+            state.candidates.push_back(i);
+        }
+        return;
+    }
+
+    auto add = [&state](int i) {
+        if (!state.marked[i]) {
+            state.marked[i] = 1;
+            state.candidates.push_back(i);
+        }
+    };
+
+    for (size_t i = 0; i < start_times.size(); i++) {
+        if (state.overflow[i] > 0) {
+            add(i);
+            continue;
+        }
+        const WorkloadEntry* end = this->problem->WorkloadEnd(i, start_times[i]);
+        for (const WorkloadEntry* entry = this->problem->WorkloadBegin(i, start_times[i]); entry != end; ++entry) {
+            if (state.profile.CellViolation(entry->resource, entry->t) > 0) {
+                add(i);
+                break;
+            }
+        }
+    }
+
+    for (size_t e = 0; e < this->problem->exclusions.size(); e++) {
+        if (state.overlap[e] > 0) {
+            add(this->problem->exclusions[e].first);
+            add(this->problem->exclusions[e].second);
+        }
+    }
+
+    for (int i : state.candidates) {
+        state.marked[i] = 0;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef REPAIR_HPP
+#define REPAIR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <span>
+#include <vector>
+#include <omp.h>
+#include "problem.hpp"
+#include "resource_profile.hpp"
+
+using namespace std;
+
+// Time a single repair may take, in seconds.
+const double REPAIR_TIME_LIMIT = 0.001;
+
+// Greedy feasibility repair. Interventions involved in a violated resource
+// cell, an exclusion or a window past T are moved, one at a time, to the
+// start in their domain that lowers the total violation the most, the one
+// with the lowest mean risk on ties. It stops when the schedule is feasible,
+// when no move lowers the violation or when the time limit is reached.
+//
+// Resource usage and exclusion overlaps are kept incrementally, in per-thread
+// state, so one Repair may be shared by the threads of a parallel loop.
+class Repair {
+public:
+    Problem* problem;
+    atomic<size_t> calls = 0;
+    atomic<size_t> infeasible = 0;
+    atomic<size_t> repaired = 0;
+    atomic<size_t> moves = 0;
+
+    Repair(Problem* problem);
+
+    // Returns whether start_times is feasible afterwards.
+    bool Apply(span<int> start_times, double time_limit = REPAIR_TIME_LIMIT);
+
+private:
+    struct State {
+        ResourceProfile profile;
+        vector<int> overlap;
+        vector<int> overflow;
+        vector<char> marked;
+        vector<int> candidates;
+
+        State(Problem* problem) : profile(problem) {}
+    };
+
+    vector<State> states;
+
+    State& Local();
+    int Overflow(int intervention, int start_time) const;
+    int ExclusionDelta(const State& state, span<const int> start_times, int intervention, int new_start) const;
+    void Candidates(State& state, span<const int> start_times, bool all);
+};
+
+#endif
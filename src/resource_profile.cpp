@@ -0,0 +1,150 @@
+#include "resource_profile.hpp"
+
+ResourceProfile::ResourceProfile(Problem* problem) {
+    this->problem = problem;
+
+    size_t cells = problem->resources.size() * problem->time_steps;
+    this->usage.resize(cells, 0.0);
+    this->cell_violation.resize(cells, 0.0f);
+    this->violated_position.resize(cells, -1);
+    this->marked.resize(cells, 0);
+
+    for (size_t cell = 0; cell < cells; cell++) {
+        SetViolation(cell, ViolationOf(cell, 0.0));
+    }
+}
+
+ResourceProfile::ResourceProfile(Problem* problem, span<const int> start_times) : ResourceProfile(problem) {
+    Reset(start_times);
+}
+
+void ResourceProfile::Reset(span<const int> start_times) {
+    fill(this->usage.begin(), this->usage.end(), 0.0);
+
+    for (size_t i = 0; i < start_times.size(); i++) {
+        if (!this->problem->ValidStart(i, start_times[i])) {
+            continue;
+        }
+        const WorkloadEntry* end = this->problem->WorkloadEnd(i, start_times[i]);
+        for (const WorkloadEntry* entry = this->problem->WorkloadBegin(i, start_times[i]); entry != end; ++entry) {
+            this->usage[Cell(entry->resource, entry->t)] += entry->amount;
+        }
+    }
+
+    this->violated.clear();
+    fill(this->violated_position.begin(), this->violated_position.end(), -1);
+    fill(this->cell_violation.begin(), this->cell_violation.end(), 0.0f);
+    this->violation = 0.0;
+
+    for (size_t cell = 0; cell < this->usage.size(); cell++) {
+        SetViolation(cell, ViolationOf(cell, this->usage[cell]));
+    }
+}
+
+void ResourceProfile::Add(int intervention, int start_time) {
+    Update(intervention, start_time, 1.0);
+}
+
+void ResourceProfile::Remove(int intervention, int start_time) {
+    Update(intervention, start_time, -1.0);
+}
+
+void ResourceProfile::Move(int intervention, int old_start, int new_start) {
+    if (old_start == new_start) {
+        return;
+    }
+    Remove(intervention, old_start);
+    Add(intervention, new_start);
+}
+
+double ResourceProfile::MoveDelta(int intervention, int old_start, int new_start) {
+    size_t violated_after = 0;
+    return TryMove(intervention, old_start, new_start, violated_after);
+}
+
+double ResourceProfile::MoveViolation(int intervention, int old_start, int new_start) {
+    size_t violated_after = 0;
+    double delta = TryMove(intervention, old_start, new_start, violated_after);
+    return violated_after == 0 ? 0.0 : max(0.0, this->violation + delta);
+}
+
+double ResourceProfile::TryMove(int intervention, int old_start, int new_start, size_t& violated_after) {
+    violated_after = this->violated.size();
+    if (old_start == new_start) {
+        return 0.0;
+    }
+
+    this->touched.clear();
+    this->touched_usage.clear();
+
+    for (auto [start, sign] : { pair(old_start, -1.0), pair(new_start, 1.0) }) {
+        if (!this->problem->ValidStart(intervention, start)) {
+            continue;
+        }
+        const WorkloadEntry* end = this->problem->WorkloadEnd(intervention, start);
+        for (const WorkloadEntry* entry = this->problem->WorkloadBegin(intervention, start); entry != end; ++entry) {
+            int cell = Cell(entry->resource, entry->t);
+            this->touched.push_back(cell);
+            this->touched_usage.push_back(this->usage[cell]);
+            this->usage[cell] += sign * entry->amount;
+        }
+    }
+
+    double delta = 0.0;
+    for (int cell : this->touched) {
+        if (!this->marked[cell]) {
+            this->marked[cell] = 1;
+            float after = ViolationOf(cell, this->usage[cell]);
+            delta += after - this->cell_violation[cell];
+            violated_after += (after > 0) - (this->cell_violation[cell] > 0);
+        }
+    }
+
+    // Restore in reverse so that a cell touched twice ends at its first value.
+    for (size_t k = this->touched.size(); k-- > 0;) {
+        this->usage[this->touched[k]] = this->touched_usage[k];
+        this->marked[this->touched[k]] = 0;
+    }
+
+    return delta;
+}
+
+void ResourceProfile::Update(int intervention, int start_time, double sign) {
+    if (!this->problem->ValidStart(intervention, start_time)) {
+        return;
+    }
+
+    const WorkloadEntry* end = this->problem->WorkloadEnd(intervention, start_time);
+    for (const WorkloadEntry* entry = this->problem->WorkloadBegin(intervention, start_time); entry != end; ++entry) {
+        int cell = Cell(entry->resource, entry->t);
+        this->usage[cell] += sign * entry->amount;
+        SetViolation(cell, ViolationOf(cell, this->usage[cell]));
+    }
+}
+
+float ResourceProfile::ViolationOf(int cell, double total) const {
+    return this->problem->ResourceViolation(CellResource(cell), CellTime(cell), float(total));
+}
+
+void ResourceProfile::SetViolation(int cell, float value) {
+    this->violation += double(value) - double(this->cell_violation[cell]);
+    this->cell_violation[cell] = value;
+
+    int& position = this->violated_position[cell];
+    if (value > 0 && position < 0) {
+        position = this->violated.size();
+        this->violated.push_back(cell);
+    }
+    else if (value == 0 && position >= 0) {
+        int last = this->violated.back();
+        this->violated[position] = last;
+        this->violated_position[last] = position;
+        this->violated.pop_back();
+        position = -1;
+    }
+
+    // Do not let rounding in the running total report a feasible profile as violated.
+    if (this->violated.empty()) {
+        this->violation = 0.0;
+    }
+}
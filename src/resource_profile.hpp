@@ -0,0 +1,63 @@
+#ifndef RESOURCE_PROFILE_HPP
+#define RESOURCE_PROFILE_HPP
+
+#include <span>
+#include <vector>
+#include "problem.hpp"
+
+using namespace std;
+
+// Resource usage of a schedule, usage[r * T + t - 1], with the min/max
+// violation of every (resource, t) cell. Adding or removing one
+// intervention's footprint only touches the cells of its workload entries,
+// and keeps the total violation and the set of violated cells up to date.
+//
+// Cell violations are Problem::ResourceViolation, as in ResourceConstraint.
+// Usage is kept in double so that adding and removing footprints does not
+// drift across its tolerance; Reset rebuilds it from scratch.
+class ResourceProfile {
+public:
+    Problem* problem;
+
+    ResourceProfile(Problem* problem);
+    ResourceProfile(Problem* problem, span<const int> start_times);
+
+    void Reset(span<const int> start_times);
+    void Add(int intervention, int start_time);
+    void Remove(int intervention, int start_time);
+    void Move(int intervention, int old_start, int new_start);
+
+    // Change in total violation if the intervention moved, without applying it.
+    double MoveDelta(int intervention, int old_start, int new_start);
+    // Total violation if the intervention moved, without applying it; zero
+    // when no cell would remain violated.
+    double MoveViolation(int intervention, int old_start, int new_start);
+
+    double Violation() const { return this->violation; }
+    double Usage(int resource, int t) const { return this->usage[Cell(resource, t)]; }
+    float CellViolation(int resource, int t) const { return this->cell_violation[Cell(resource, t)]; }
+
+    // Cells with a nonzero violation, as r * T + t - 1, in no particular order.
+    span<const int> ViolatedCells() const { return this->violated; }
+    int CellResource(int cell) const { return cell / this->problem->time_steps; }
+    int CellTime(int cell) const { return cell % this->problem->time_steps + 1; }
+
+private:
+    vector<double> usage;
+    vector<float> cell_violation;
+    vector<int> violated;
+    vector<int> violated_position;
+    double violation = 0.0;
+
+    vector<int> touched;
+    vector<double> touched_usage;
+    vector<char> marked;
+
+    int Cell(int resource, int t) const { return resource * this->problem->time_steps + t - 1; }
+    float ViolationOf(int cell, double usage) const;
+    double TryMove(int intervention, int old_start, int new_start, size_t& violated_after);
+    void Update(int intervention, int start_time, double sign);
+    void SetViolation(int cell, float value);
+};
+
+#endif
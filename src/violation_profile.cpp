@@ -0,0 +1,117 @@
+#include "violation_profile.hpp"
+
+ViolationProfile::ViolationProfile(Problem* problem, size_t sample_rate) : profile(problem) {
+    this->problem = problem;
+    this->sample_rate = max<size_t>(1, sample_rate);
+
+    size_t cells = problem->resources.size() * problem->time_steps;
+    for (Tally& tally : this->tallies) {
+        tally.cell_hits.resize(cells, 0);
+        tally.cell_amount.resize(cells, 0.0);
+        tally.exclusion_hits.resize(problem->exclusions.size(), 0);
+        tally.exclusion_steps.resize(problem->exclusions.size(), 0);
+        tally.overflow_hits.resize(problem->interventions.size(), 0);
+        tally.overflow_steps.resize(problem->interventions.size(), 0);
+    }
+}
+
+void ViolationProfile::Record(span<const span<const int>> schedules, Stage stage) {
+    Tally& tally = this->tallies[int(stage)];
+
+    // The k-th schedule ever recorded is sampled when k is a multiple of the rate.
+    size_t first = (this->sample_rate - tally.recorded % this->sample_rate) % this->sample_rate;
+    tally.recorded += schedules.size();
+    if (first >= schedules.size()) {
+        return;
+    }
+
+    for (size_t k = first; k < schedules.size(); k += this->sample_rate) {
+        Sample(schedules[k], tally);
+        tally.sampled++;
+    }
+}
+
+void ViolationProfile::Sample(span<const int> start_times, Tally& tally) {
+    int time_steps = this->problem->time_steps;
+
+    for (size_t i = 0; i < start_times.size(); i++) {
+        int start_time = start_times[i];
+        if (!this->problem->ValidStart(i, start_time)) {
+            // Zero means unscheduled; anything else is past tmax.
+            if (start_time != 0) {
+                tally.overflow_hits[i]++;
+            }
+            continue;
+        }
+
+        int overflow = this->problem->EndTime(i, start_time) - time_steps;
+        if (overflow > 0) {
+            tally.overflow_hits[i]++;
+            tally.overflow_steps[i] += overflow;
+        }
+    }
+
+    this->profile.Reset(start_times);
+    for (int cell : this->profile.ViolatedCells()) {
+        tally.cell_hits[cell]++;
+        tally.cell_amount[cell] += this->profile.CellViolation(this->profile.CellResource(cell), this->profile.CellTime(cell));
+    }
+
+    for (size_t e = 0; e < this->problem->exclusions.size(); e++) {
+        const Exclusion& exclusion = this->problem->exclusions[e];
+        int overlap = this->problem->ExclusionOverlap(e, start_times[exclusion.first], start_times[exclusion.second]);
+        if (overlap > 0) {
+            tally.exclusion_hits[e]++;
+            tally.exclusion_steps[e] += overlap;
+        }
+    }
+}
+
+void ViolationProfile::Write(int run) const {
+    ofstream file("logs/violations_" + this->problem->file_name + ".csv", run == 0 ? ios::trunc : ios::app);
+
+    // stage is generated (before repair) or evaluated (after repair and the
+    // cache). hits counts the sampled schedules with the violation; amount is
+    // the violated quantity summed over them (resource units or time steps).
+    // The samples row holds the sampled and the recorded schedule counts.
+    if (run == 0) {
+        file << "run,stage,kind,name,interventions,t,hits,amount\n";
+    }
+
+    Write(file, run, Stage::Generated);
+    Write(file, run, Stage::Evaluated);
+}
+
+void ViolationProfile::Write(ofstream& file, int run, Stage stage) const {
+    const Tally& tally = this->tallies[int(stage)];
+    string prefix = to_string(run) + (stage == Stage::Generated ? ",generated," : ",evaluated,");
+    int time_steps = this->problem->time_steps;
+
+    file << prefix << "samples,,,," << tally.sampled << "," << tally.recorded << "\n";
+
+    for (size_t r = 0; r < this->problem->resources.size(); r++) {
+        for (int t = 1; t <= time_steps; t++) {
+            size_t cell = r * time_steps + t - 1;
+            if (tally.cell_hits[cell] > 0) {
+                file << prefix << "resource," << this->problem->resources[r].name << ",," << t << "," <<
+                    tally.cell_hits[cell] << "," << tally.cell_amount[cell] << "\n";
+            }
+        }
+    }
+
+    for (size_t e = 0; e < this->problem->exclusions.size(); e++) {
+        if (tally.exclusion_hits[e] > 0) {
+            const Exclusion& exclusion = this->problem->exclusions[e];
+            file << prefix << "exclusion," << exclusion.name << "," << this->problem->interventions[exclusion.first].name << " " <<
+                this->problem->interventions[exclusion.second].name << ",," << tally.exclusion_hits[e] << "," <<
+                tally.exclusion_steps[e] << "\n";
+        }
+    }
+
+    for (size_t i = 0; i < this->problem->interventions.size(); i++) {
+        if (tally.overflow_hits[i] > 0) {
+            file << prefix << "overflow," << this->problem->interventions[i].name << ",,," << tally.overflow_hits[i] << "," <<
+                tally.overflow_steps[i] << "\n";
+        }
+    }
+}
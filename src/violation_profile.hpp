@@ -0,0 +1,61 @@
+#ifndef VIOLATION_PROFILE_HPP
+#define VIOLATION_PROFILE_HPP
+
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+#include "problem.hpp"
+#include "resource_profile.hpp"
+
+using namespace std;
+
+// One in this many recorded schedules is broken down into its violations.
+const size_t VIOLATION_SAMPLE_RATE = 128;
+
+// Histogram of the constraint violations met during one search: how often
+// each (resource, t) cell, exclusion and intervention overflowing T or its
+// tmax was violated, and by how much, over a sample of the schedules.
+//
+// Schedules are tallied in two stages: as generated, before any repair, and
+// as evaluated, after repair and the fitness cache. Repair hides exactly the
+// violations the search keeps running into, so only the first stage shows them.
+//
+// Record is meant to be called once per batch, outside parallel regions; only
+// the sampled schedules cost more than a counter increment.
+class ViolationProfile {
+public:
+    enum class Stage { Generated, Evaluated };
+
+    Problem* problem;
+
+    ViolationProfile(Problem* problem, size_t sample_rate = VIOLATION_SAMPLE_RATE);
+
+    void Record(span<const span<const int>> schedules, Stage stage);
+
+    // Appends the rows of this profile, tagged with run, to
+    // logs/violations_<instance>.csv, next to the run log. Run 0 starts the
+    // file over.
+    void Write(int run) const;
+
+private:
+    struct Tally {
+        size_t recorded = 0;
+        size_t sampled = 0;
+        vector<size_t> cell_hits;
+        vector<double> cell_amount;
+        vector<size_t> exclusion_hits;
+        vector<size_t> exclusion_steps;
+        vector<size_t> overflow_hits;
+        vector<size_t> overflow_steps;
+    };
+
+    size_t sample_rate;
+    Tally tallies[2];
+    ResourceProfile profile;
+
+    void Sample(span<const int> start_times, Tally& tally);
+    void Write(ofstream& file, int run, Stage stage) const;
+};
+
+#endif
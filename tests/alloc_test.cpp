@@ -0,0 +1,117 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "../src/problem.hpp"
+#include "../src/reader.hpp"
+#include "../src/optimization.hpp"
+
+using namespace std;
+
+// Every operator new of the process is counted, so the evaluations below can
+// be checked not to touch the heap once their scratch buffers exist.
+namespace {
+    atomic<size_t> allocations = 0;
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    void* pointer = malloc(size > 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+// Checks that ConstraintSatisfied + ObjectiveFunction and EvaluateBatch, with
+// and without cutoffs, make no heap allocation per evaluation after a first
+// warm-up call. Four threads are used whatever the host, so that a batch of
+// one always takes the path that splits its time steps over threads.
+//
+// usage: alloc_test [instance]
+int main(int argc, char** argv) {
+    string input_file = argc > 1 ? argv[1] : "input/A_09.json";
+
+    FILE* fp = fopen(input_file.c_str(), "r");
+    if (!fp) {
+        cerr << "Could not open " << input_file << endl;
+        return 1;
+    }
+    Problem problem("alloc_test");
+    InstanceReader reader(&problem);
+    rapidjson::ParseResult result = reader.Read(fp);
+    fclose(fp);
+    if (result.IsError()) {
+        cerr << "Could not parse " << input_file << endl;
+        return 1;
+    }
+
+    omp_set_num_threads(4);
+    Optimization optimization(&problem);
+    if (optimization.StepThreads(1) < 2) {
+        cerr << input_file << ": a single schedule is not split over threads" << endl;
+        return 1;
+    }
+
+    mt19937 generator(7);
+    vector<vector<int>> population(64);
+    for (auto& start_times : population) {
+        for (const auto& intervention : problem.interventions) {
+            start_times.push_back(uniform_int_distribution<int>(0, intervention.tmax)(generator));
+        }
+    }
+    vector<span<const int>> views(population.begin(), population.end());
+    vector<tuple<float, float, float>> results(population.size());
+    vector<float> cutoffs(population.size());
+
+    auto single = [&]() {
+        for (const auto& start_times : population) {
+            auto [violated, penalty] = optimization.ConstraintSatisfied(start_times);
+            optimization.ObjectiveFunction(start_times, penalty);
+        }
+    };
+    auto batch = [&]() {
+        optimization.EvaluateBatch(views, results);
+    };
+    auto batch_cutoffs = [&]() {
+        for (size_t k = 0; k < population.size(); k++) {
+            cutoffs[k] = get<0>(results[(k + 1) % results.size()]);
+        }
+        optimization.EvaluateBatch(views, results, cutoffs);
+    };
+    auto single_schedule = [&]() {
+        optimization.EvaluateBatch(span(views).first(1), span(results).first(1));
+    };
+
+    int failures = 0;
+    auto measure = [&](const string& name, auto evaluate) {
+        evaluate();
+        size_t before = allocations;
+        evaluate();
+        size_t count = allocations - before;
+
+        cout << input_file << ": " << name << " allocations " << count << endl;
+        failures += count > 0;
+    };
+
+    measure("single", single);
+    measure("batch", batch);
+    measure("batch with cutoffs", batch_cutoffs);
+    measure("batch of one", single_schedule);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#include "mapped_file.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace utils {
+    MappedFile::MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return;
+        }
+
+        // Reserve one byte past the end in anonymous zeroed memory, then map
+        // the file over the start of the reservation.
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t size = st.st_size;
+        size_t length = (size + 1 + page - 1) / page * page;
+
+        void* region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            close(fd);
+            return;
+        }
+
+        if (size > 0 && mmap(region, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_POPULATE, fd, 0) == MAP_FAILED) {
+            munmap(region, length);
+            close(fd);
+            return;
+        }
+
+        close(fd);
+
+        this->data = static_cast<char*>(region);
+        this->size = size;
+        this->length = length;
+    }
+
+    MappedFile::~MappedFile() {
+        if (this->data) {
+            munmap(this->data, this->length);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <cstddef>
+
+namespace utils {
+    // Private copy-on-write mapping of a whole file, followed by at least one
+    // zero byte so it can be parsed in situ as a C string.
+    class MappedFile {
+    public:
+        char* data = nullptr;
+        size_t size = 0;
+
+        MappedFile(const std::string& path);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        bool IsOpen() const { return this->data != nullptr; }
+
+    private:
+        size_t length = 0;
+    };
+};
+
+#endif
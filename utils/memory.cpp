@@ -0,0 +1,10 @@
+#include "memory.hpp"
+#include <sys/resource.h>
+
+namespace utils {
+    long PeakMemory() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+}
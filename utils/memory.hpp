@@ -0,0 +1,9 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+namespace utils {
+    // Peak resident set size of the process, in kilobytes.
+    long PeakMemory();
+};
+
+#endif